@@ -0,0 +1,291 @@
+ /* Copyright (c) 2018 Richie Mickan. All Rights Reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>. *
+ */
+
+#include "Arduino.h"
+#include "ESP32_IR_Batch.h"
+
+////////////////////////////////////
+#define         DEBUG       false
+////////////////////////////////////
+
+//Signed lanes - RMT durations are 15 bits, so they fit, and the compares stay 16 bits wide.
+typedef int16_t     BatchLanes      __attribute__((vector_size(BATCH_LANES * sizeof(int16_t))));
+typedef uint8_t     BatchClasses    __attribute__((vector_size(BATCH_LANES * sizeof(uint8_t))));
+
+#define PADDED(_count)  ((((_count) + BATCH_LANES - 1) / BATCH_LANES) * BATCH_LANES)
+
+//Class bit -> the duration it stands for, in the order of the CLASS_ bits
+static const unsigned int classDuration[CLASS_COUNT] =
+{
+    PRE_SYNC_MARK, PRE_SYNC_SPACE, TAG_PACKET_HEADER, BEACON_HEADER, MARK_SPACE, ZERO_BIT, ONE_BIT
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+ESP32_IRbatchDecoder::ESP32_IRbatchDecoder(int _maxItems, int _maxFrames)
+{
+    maxItems    = PADDED(_maxItems);
+    maxFrames   = _maxFrames;
+    marks       = new uint16_t[maxItems];
+    spaces      = new uint16_t[maxItems];
+    markClass   = new uint8_t[maxItems];
+    spaceClass  = new uint8_t[maxItems];
+    frameStart  = new uint32_t[maxFrames];
+    frameItems  = new uint16_t[maxFrames];
+    types       = new char[maxFrames];
+    values      = new uint32_t[maxFrames];
+    valid       = new uint8_t[maxFrames];
+
+    for(int index = 0; index < CLASS_COUNT; index++)    window(classDuration[index], windowMin[index], windowMax[index]);
+    clear();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+ESP32_IRbatchDecoder::~ESP32_IRbatchDecoder()
+{
+    delete[] marks;
+    delete[] spaces;
+    delete[] markClass;
+    delete[] spaceClass;
+    delete[] frameStart;
+    delete[] frameItems;
+    delete[] types;
+    delete[] values;
+    delete[] valid;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRbatchDecoder::clear()
+{
+    itemCount   = 0;
+    frameCount  = 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//checkData() compares the integer duration with (E - E * VARIATION) and (E + E * VARIATION) as
+//doubles. Rounding those same doubles inwards gives integer bounds that accept exactly the same values.
+void ESP32_IRbatchDecoder::window(unsigned int _expectedDuration, uint16_t &_min, uint16_t &_max)
+{
+    double _low     = ceil(_expectedDuration - (_expectedDuration * VARIATION));
+    double _high    = floor(_expectedDuration + (_expectedDuration * VARIATION));
+    _min = (_low  < 0)     ? 0     : (uint16_t)_low;
+    _max = (_high > 65535) ? 65535 : (uint16_t)_high;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+bool ESP32_IRbatchDecoder::addFrame(const rmt_item32_t *_items, int _numItems)
+{
+    if(frameCount >= maxFrames || itemCount + _numItems > maxItems || _numItems > 0xFFFF)   return false;
+
+    frameStart[frameCount] = itemCount;
+    frameItems[frameCount] = _numItems;
+    for(int index = 0; index < _numItems; index++)
+    {
+        marks[itemCount]    = _items[index].duration0;      //15 bits, see BatchLanes
+        spaces[itemCount]   = _items[index].duration1;
+        itemCount++;
+    }
+    frameCount++;
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//Sets a class bit for every window in _classMask each duration falls in, BATCH_LANES durations per
+//compare. The windows are copied to locals first - _classes is a byte pointer, so the compiler would
+//otherwise reload them after every store.
+void ESP32_IRbatchDecoder::classify(const uint16_t *_durations, uint8_t *_classes, int _count, uint8_t _classMask)
+{
+    BatchLanes  _min[CLASS_COUNT];
+    BatchLanes  _max[CLASS_COUNT];
+    BatchLanes  _bit[CLASS_COUNT];
+    int         _windows = 0;
+    for(int _class = 0; _class < CLASS_COUNT; _class++)
+    {
+        if(!(_classMask & (1 << _class)))   continue;
+        _min[_windows] = (int16_t)windowMin[_class] - (BatchLanes){};
+        _max[_windows] = (int16_t)windowMax[_class] - (BatchLanes){};
+        _bit[_windows] = (int16_t)(1 << _class)     - (BatchLanes){};
+        _windows++;
+    }
+
+    for(int _base = 0; _base < _count; _base += BATCH_LANES)
+    {
+        BatchLanes _lanes;
+        memcpy(&_lanes, &_durations[_base], sizeof(_lanes));
+
+        BatchLanes _bits = {};
+        for(int _window = 0; _window < _windows; _window++)
+        {
+            _bits |= (_lanes >= _min[_window]) & (_lanes <= _max[_window]) & _bit[_window];
+        }
+        BatchClasses _narrow = __builtin_convertvector(_bits, BatchClasses);
+        memcpy(&_classes[_base], &_narrow, sizeof(_narrow));
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+int ESP32_IRbatchDecoder::decode()
+{
+    //Zero the padding, so the last vector compares known values.
+    for(int index = itemCount; index < PADDED(itemCount); index++)
+    {
+        marks[index]    = 0;
+        spaces[index]   = 0;
+    }
+    classify(marks,  markClass,  PADDED(itemCount), CLASS_PRE_SYNC_MARK | CLASS_TAG_HEADER | CLASS_BEACON_HEADER | CLASS_ZERO_BIT | CLASS_ONE_BIT);
+    classify(spaces, spaceClass, PADDED(itemCount), CLASS_PRE_SYNC_SPACE | CLASS_MARK_SPACE);
+
+    int _validFrames = 0;
+    for(int _frame = 0; _frame < frameCount; _frame++)
+    {
+        decodeFrame(_frame);
+        if(valid[_frame])   _validFrames++;
+    }
+    if(DEBUG)
+    {
+        Serial.print("ESP32_IRbatchDecoder::decode() - frames = ");  Serial.print(frameCount);
+        Serial.print(", valid = ");                                  Serial.println(_validFrames);
+    }
+    return _validFrames;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//parseLTTO(), reading class bits instead of calling checkData().
+void ESP32_IRbatchDecoder::decodeFrame(int _frame)
+{
+    int             _numItems   = frameItems[_frame];
+    const uint8_t  *_mark       = &markClass[frameStart[_frame]];
+    const uint8_t  *_space      = &spaceClass[frameStart[_frame]];
+
+    types[_frame]   = ' ';
+    values[_frame]  = 0;
+    valid[_frame]   = false;
+    if(_numItems < 2)   return;         //no pre-sync and header, as parseLTTO()
+
+    bool        _validPreSync   = (_mark[0] & CLASS_PRE_SYNC_MARK) && (_space[0] & CLASS_PRE_SYNC_SPACE);
+    int         _bitCount       = _numItems - 2;
+    uint32_t    _totalOfBits    = 0;
+    bool        _badData        = false;
+    uint8_t     _allSpaces      = CLASS_MARK_SPACE;
+
+    for(int index = 2; index < _numItems; index++)
+    {
+        uint8_t _bit = _mark[index];
+        if      (_bit & CLASS_ONE_BIT)  _totalOfBits = (_totalOfBits << 1) | 1;
+        else if (_bit & CLASS_ZERO_BIT) _totalOfBits = _totalOfBits << 1;
+        else                            _badData = true;    //a bad bit isn't shifted in, as parseLTTO()
+        if(index < _numItems - 1)   _allSpaces &= _space[index];
+    }
+    values[_frame] = _totalOfBits;
+
+    bool _validHeader = true;
+    if(_mark[1] & CLASS_TAG_HEADER)
+    {
+        switch(_bitCount)
+        {
+            case TAG_BIT_COUNT:     types[_frame] = 'T';                                                    break;
+            case PACKET_BIT_COUNT:  types[_frame] = (_totalOfBits < CHECKSUM_BIT_SET) ? 'P' : 'C';          break;
+            case DATA_BIT_COUNT:    types[_frame] = 'D';                                                    break;
+            default:                types[_frame] = 'V';                                                    break;
+        }
+    }
+    else if(_mark[1] & CLASS_BEACON_HEADER)
+    {
+        switch(_bitCount)
+        {
+            case BEACON_BIT_COUNT:      types[_frame] = 'Z';    break;
+            case LTAR_BEACON_BIT_COUNT: types[_frame] = 'E';    break;
+            default:                    types[_frame] = 'V';    break;
+        }
+    }
+    else _validHeader = false;
+
+    valid[_frame] = _validPreSync && _validHeader && !_badData && (_allSpaces & CLASS_MARK_SPACE);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+int ESP32_IRbatchDecoder::verify()
+{
+    int _mismatches = 0;
+    int _largest    = 0;
+    for(int _frame = 0; _frame < frameCount; _frame++)
+    {
+        if(frameItems[_frame] > _largest)   _largest = frameItems[_frame];
+    }
+    if(_largest < 2)    return 0;
+
+    //parseLTTO() wants items, so each frame is put back together here - off the stack, it can be big.
+    rmt_item32_t *_items = new rmt_item32_t[_largest];
+
+    for(int _frame = 0; _frame < frameCount; _frame++)
+    {
+        int _numItems = frameItems[_frame];
+        if(_numItems < 2)   continue;
+
+        for(int index = 0; index < _numItems; index++)
+        {
+            _items[index].duration0 = marks[frameStart[_frame] + index];
+            _items[index].level0    = 1;
+            _items[index].duration1 = spaces[frameStart[_frame] + index];
+            _items[index].level1    = 0;
+        }
+
+        LttoMessage _message;
+        bool _valid = ESP32_IRrxBase::parseLTTO(_items, _numItems, _message);
+        if(_valid != (bool)valid[_frame] || _message.type != types[_frame] || _message.data != values[_frame])
+        {
+            _mismatches++;
+            if(DEBUG)   { Serial.print("ESP32_IRbatchDecoder::verify() - mismatch in frame "); Serial.println(_frame); }
+        }
+    }
+    delete[] _items;
+    return _mismatches;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+int ESP32_IRbatchDecoder::readFrameCount()
+{
+    return frameCount;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+char ESP32_IRbatchDecoder::readType(int _frame)
+{
+    return (_frame >= 0 && _frame < frameCount) ? types[_frame] : ' ';
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t ESP32_IRbatchDecoder::readData(int _frame)
+{
+    return (_frame >= 0 && _frame < frameCount) ? values[_frame] : 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+bool ESP32_IRbatchDecoder::readValid(int _frame)
+{
+    return (_frame >= 0 && _frame < frameCount) ? valid[_frame] : false;
+}
@@ -0,0 +1,97 @@
+ /* Copyright (c) 2018 Richie Mickan. All Rights Reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>. *
+ */
+
+/* Bulk LTTO/LTAR decoding of recorded bursts, for post-game analysis and tolerance tuning.
+ * Frames are added to struct-of-arrays storage (all marks, all spaces), every duration is classified
+ * against the decoder's windows BATCH_LANES at a time with GCC vector extensions, then each frame is
+ * decoded from its class bits.
+ * The vector compares are SIMD on a PC (SSE2/NEON), where a capture log of millions of bursts is
+ * worth decoding in bulk - on the ESP32 GCC lowers them to plain code, which still works.
+ * The windows are the integer equivalents of checkData()'s float ones, so the result is the same
+ * type, data and validity as parseLTTO() - verify() checks that, frame by frame.
+ * Storage is 6 bytes per item and 12 per frame, allocated up front. The defaults take about 8M on
+ * a PC, and about 15K on the ESP32.
+ */
+
+#ifndef ESP32_IR_BATCH_H_
+#define ESP32_IR_BATCH_H_
+
+#include "ESP32_IR_LTTO.h"
+
+#define BATCH_LANES             8       //durations per vector compare (one 128 bit register)
+#ifndef BATCH_MAX_ITEMS
+#if defined(ESP_PLATFORM)
+#define BATCH_MAX_ITEMS         2048
+#define BATCH_MAX_FRAMES        256
+#else
+#define BATCH_MAX_ITEMS         1048576 //a log this big is decoded in batches - clear() between them
+#define BATCH_MAX_FRAMES        131072
+#endif
+#endif
+
+//Duration class bits, one per window
+#define CLASS_PRE_SYNC_MARK     0x01
+#define CLASS_PRE_SYNC_SPACE    0x02
+#define CLASS_TAG_HEADER        0x04
+#define CLASS_BEACON_HEADER     0x08
+#define CLASS_MARK_SPACE        0x10
+#define CLASS_ZERO_BIT          0x20
+#define CLASS_ONE_BIT           0x40
+#define CLASS_COUNT             7
+
+class ESP32_IRbatchDecoder {
+  public:
+    ESP32_IRbatchDecoder(int _maxItems = BATCH_MAX_ITEMS, int _maxFrames = BATCH_MAX_FRAMES);
+    ~ESP32_IRbatchDecoder();
+    ESP32_IRbatchDecoder(const ESP32_IRbatchDecoder &) = delete;           //owns its storage
+    ESP32_IRbatchDecoder &operator=(const ESP32_IRbatchDecoder &) = delete;
+
+    void        clear();
+    bool        addFrame(const rmt_item32_t *_items, int _numItems);
+    int         decode();                       //returns the number of valid frames
+    int         verify();                       //re-decodes every frame with parseLTTO(), returns mismatches
+
+    int         readFrameCount();
+    char        readType(int _frame);
+    uint32_t    readData(int _frame);
+    bool        readValid(int _frame);
+
+    //The smallest and largest duration checkData() accepts for _expectedDuration
+    static void window(unsigned int _expectedDuration, uint16_t &_min, uint16_t &_max);
+
+  private:
+    int         maxItems;
+    int         maxFrames;
+    int         itemCount;
+    int         frameCount;
+
+    uint16_t   *marks;                          //[item], padded to BATCH_LANES
+    uint16_t   *spaces;
+    uint8_t    *markClass;
+    uint8_t    *spaceClass;
+    uint32_t   *frameStart;                     //[frame]
+    uint16_t   *frameItems;
+    char       *types;
+    uint32_t   *values;
+    uint8_t    *valid;
+
+    uint16_t    windowMin[CLASS_COUNT];
+    uint16_t    windowMax[CLASS_COUNT];
+
+    void        classify(const uint16_t *_durations, uint8_t *_classes, int _count, uint8_t _classMask);
+    void        decodeFrame(int _frame);
+};
+
+#endif /* ESP32_IR_BATCH_H_ */
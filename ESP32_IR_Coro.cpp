@@ -0,0 +1,181 @@
+ /* Copyright (c) 2018 Richie Mickan. All Rights Reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>. *
+ */
+
+#include "Arduino.h"
+#include "ESP32_IR_Coro.h"
+#include "ESP32_IR_Sim.h"
+
+#if defined(__cpp_impl_coroutine)
+
+////////////////////////////////////
+#define         DEBUG       false
+////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void IRwaiter::await_suspend(IRtask::handle_type _task)
+{
+    IRtask::promise_type &_promise = _task.promise();
+    deadline = waitUntil ? waitUntil : _promise.scheduler->now() + waitUs;
+    _promise.scheduler->wait(_promise.slot, this);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////
+
+ESP32_IRscheduler::ESP32_IRscheduler(ESP32_IRmedium *_medium)
+{
+    medium      = _medium;
+    taskCount   = 0;
+    rxCount     = 0;
+    resumeCount = 0;
+    for(int index = 0; index < MAX_IR_TASKS; index++)
+    {
+        tasks[index]    = nullptr;
+        waiting[index]  = NULL;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+ESP32_IRscheduler::~ESP32_IRscheduler()
+{
+    for(int index = 0; index < MAX_IR_TASKS; index++)
+    {
+        if(tasks[index])    tasks[index].destroy();
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+bool ESP32_IRscheduler::attach(ESP32_IRrxBase &_rx)
+{
+    if(rxCount >= MAX_IR_SCHED_RX)  return false;
+    rxList[rxCount]         = &_rx;
+    rxMessageCount[rxCount] = _rx.readMessageCount();
+    rxCount++;
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+bool ESP32_IRscheduler::spawn(IRtask &&_task)
+{
+    for(int _slot = 0; _slot < MAX_IR_TASKS; _slot++)
+    {
+        if(tasks[_slot])    continue;
+
+        tasks[_slot] = _task.release();
+        tasks[_slot].promise().scheduler    = this;
+        tasks[_slot].promise().slot         = _slot;
+        taskCount++;
+        resume(_slot);
+        return true;
+    }
+    if(DEBUG)   Serial.println("ESP32_IRscheduler::spawn() - no free task slot");
+    return false;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+int64_t ESP32_IRscheduler::now()
+{
+    if(medium != NULL)  return medium->now();
+    return esp_timer_get_time();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRscheduler::wait(int _slot, IRwaiter *_waiter)
+{
+    waiting[_slot] = _waiter;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//Everything that has arrived is offered to the waiting tasks first, then the tasks that got what
+//they were waiting for (or ran out of time) are resumed. Resuming a task may start another wait,
+//so nothing is resumed while the waiters are being scanned.
+void ESP32_IRscheduler::poll()
+{
+    for(int _rx = 0; _rx < rxCount; _rx++)
+    {
+        ESP32_IRrxBase *_receiver = rxList[_rx];
+        while(true)
+        {
+            ESP32_IRrxItem _rxItem = _receiver->receiveItem(0);
+            if(!_rxItem)    break;
+            if(!_receiver->decodeIR(_rxItem))   continue;
+
+            bool _messageDone = _receiver->readMessageCount() != rxMessageCount[_rx];
+            rxMessageCount[_rx] = _receiver->readMessageCount();
+
+            for(int _slot = 0; _slot < MAX_IR_TASKS; _slot++)
+            {
+                IRwaiter *_waiter = waiting[_slot];
+                if(_waiter == NULL || _waiter->matched || _waiter->timeOnly())  continue;
+
+                if(_waiter->offerPacket(_receiver, _receiver->readLttoMessage())
+                   || (_messageDone && _waiter->offerMessage(_receiver, _receiver->readMessage())))
+                {
+                    _waiter->matched = true;
+                }
+            }
+        }
+    }
+
+    int64_t _now = now();
+    for(int _slot = 0; _slot < MAX_IR_TASKS; _slot++)
+    {
+        IRwaiter *_waiter = waiting[_slot];
+        if(_waiter == NULL) continue;
+
+        bool _ready = _waiter->timeOnly() ? _waiter->due(_now) : (_waiter->matched || _waiter->due(_now));
+        if(_ready)  resume(_slot);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRscheduler::resume(int _slot)
+{
+    waiting[_slot] = NULL;
+    resumeCount++;
+    tasks[_slot].resume();
+
+    if(tasks[_slot].done())
+    {
+        tasks[_slot].destroy();
+        tasks[_slot] = nullptr;
+        taskCount--;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+int ESP32_IRscheduler::readTaskCount()
+{
+    return taskCount;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t ESP32_IRscheduler::readResumeCount()
+{
+    return resumeCount;
+}
+
+#endif /* __cpp_impl_coroutine */
@@ -0,0 +1,251 @@
+ /* Copyright (c) 2018 Richie Mickan. All Rights Reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>. *
+ */
+
+/* Multi-step IR exchanges (join, hosting, debrief) written as C++20 coroutines.
+ * An IRtask can co_await irSend(), irDelay(), irReceivePacket() and irReceiveMessage(). All the
+ * tasks are run by one ESP32_IRscheduler, polled from loop(), so dozens of handshakes can be in
+ * progress at once without a FreeRTOS task each.
+ *
+ *  IRtask join(ESP32_IRrxBase &rx, ESP32_IRtxBase &tx)
+ *  {
+ *      LttoHostMessage _assign;
+ *      for(int _try = 0; _try < 5; _try++)
+ *      {
+ *          if(!co_await irSend(tx, [&]{ return tx.taggerRequestToJoin(gameID, taggerID, 0); }))   continue;
+ *          if(co_await irReceiveMessage(rx, [](const LttoHostMessage &m){ return m.packetID == 1; }, 2000, _assign))
+ *          {
+ *              co_await irSend(tx, [&]{ tx.taggerAckPlayerAssign(gameID, taggerID); });
+ *              co_return;
+ *          }
+ *      }
+ *  }
+ *
+ *  scheduler.attach(rx);  scheduler.spawn(join(rx, tx));  ...  loop() { scheduler.poll(); }
+ *
+ * irSend() never blocks the scheduler. A frame held for listen-before-talk is polled from poll(),
+ * and the task resumes once it has gone out - co_await returns false if it was never sent.
+ *
+ * Needs a compiler with coroutine support (GCC 11+ with -std=gnu++20 or later), otherwise
+ * this header is empty.
+ */
+
+#ifndef ESP32_IR_CORO_H_
+#define ESP32_IR_CORO_H_
+
+#include "ESP32_IR_LTTO.h"
+
+#if defined(__cpp_impl_coroutine)
+
+#include <coroutine>
+#include <type_traits>
+
+#define MAX_IR_TASKS            32      //coroutines one scheduler can run
+#define MAX_IR_SCHED_RX         8       //receivers one scheduler reads
+
+class ESP32_IRscheduler;
+
+//The coroutine type. The scheduler owns it once spawned.
+class IRtask {
+  public:
+    struct promise_type
+    {
+        ESP32_IRscheduler  *scheduler   = nullptr;
+        int                 slot        = -1;
+
+        IRtask              get_return_object()     { return IRtask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept  { return {}; }
+        std::suspend_always final_suspend() noexcept    { return {}; }
+        void                return_void()           {}
+        void                unhandled_exception()   { abort(); }
+    };
+    typedef std::coroutine_handle<promise_type> handle_type;
+
+    IRtask(IRtask &&_other) : handle(_other.handle)     { _other.handle = nullptr; }
+    IRtask(const IRtask &) = delete;
+    IRtask &operator=(const IRtask &) = delete;
+    IRtask &operator=(IRtask &&) = delete;
+    ~IRtask()                                           { if(handle) handle.destroy(); }
+
+    handle_type         release()                       { handle_type _handle = handle; handle = nullptr; return _handle; }
+
+  private:
+    explicit IRtask(handle_type _handle) : handle(_handle) {}
+    handle_type         handle;
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//What a suspended task is waiting for. The awaiters below are all IRwaiters, and live in the
+//task's frame while it is suspended.
+class IRwaiter {
+  public:
+    int64_t         deadline    = 0;        //0 = none
+    bool            matched     = false;    //what co_await returns
+
+    virtual         ~IRwaiter()                                                 {}
+    virtual bool    timeOnly()                                                  { return false; }
+    virtual bool    due(int64_t _now)                                           { return _now >= deadline; }
+    virtual bool    offerPacket(ESP32_IRrxBase *, const LttoMessage &)          { return false; }
+    virtual bool    offerMessage(ESP32_IRrxBase *, const LttoHostMessage &)     { return false; }
+
+    bool            await_ready()                                               { return false; }
+    bool            await_resume()                                              { return matched; }
+    void            await_suspend(IRtask::handle_type _task);
+
+  protected:
+    int64_t         waitUs      = 0;        //turned into deadline when the task suspends
+    int64_t         waitUntil   = 0;        //or an absolute time
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+class ESP32_IRscheduler {
+  public:
+    ESP32_IRscheduler(ESP32_IRmedium *_medium = NULL);
+    ~ESP32_IRscheduler();
+
+    bool        attach(ESP32_IRrxBase &_rx);        //receivers whose traffic the tasks can wait for
+    bool        spawn(IRtask &&_task);              //runs it up to its first co_await
+    void        poll();                             //call from loop()
+    int64_t     now();
+
+    int         readTaskCount();
+    uint32_t    readResumeCount();
+
+    void        wait(int _slot, IRwaiter *_waiter);
+
+  private:
+    ESP32_IRmedium         *medium;
+    IRtask::handle_type     tasks[MAX_IR_TASKS];
+    IRwaiter               *waiting[MAX_IR_TASKS];
+    int                     taskCount;
+    ESP32_IRrxBase         *rxList[MAX_IR_SCHED_RX];
+    uint32_t                rxMessageCount[MAX_IR_SCHED_RX];
+    int                     rxCount;
+    uint32_t                resumeCount;
+
+    void    resume(int _slot);
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//Resumes once the transmitter has sent everything queued (including what _send queued). If _send
+//returns an LBT_ result (hostPlayerToGame(), taggerRequestToJoin()), a held frame is polled until
+//it goes, and co_await returns false if listen-before-talk gave up on it.
+class IRsendAwaiter : public IRwaiter {
+  public:
+    IRsendAwaiter(ESP32_IRtxBase &_tx, int _status) : tx(&_tx), status(_status)
+    {
+        waitUntil   = _tx.readTxDoneTime();
+        matched     = (_status != LBT_BUSY);
+    }
+    bool    timeOnly() override                     { return true; }
+
+    bool    due(int64_t _now) override
+    {
+        if(status == LBT_PENDING)
+        {
+            status = tx->pollListenBeforeTalk();
+            if(status == LBT_PENDING)   return false;
+            matched     = (status == LBT_SENT);
+            deadline    = tx->readTxDoneTime();
+        }
+        return _now >= deadline;
+    }
+
+  private:
+    ESP32_IRtxBase     *tx;
+    int                 status;
+};
+
+template <class SEND>
+IRsendAwaiter irSend(ESP32_IRtxBase &_tx, SEND _send)
+{
+    if constexpr (std::is_void<decltype(_send())>::value)
+    {
+        _send();
+        return IRsendAwaiter(_tx, LBT_SENT);
+    }
+    else    return IRsendAwaiter(_tx, _send());
+}
+
+class IRdelayAwaiter : public IRwaiter {
+  public:
+    IRdelayAwaiter(uint32_t _ms)                    { waitUs = (int64_t)_ms * 1000; matched = true; }
+    bool    timeOnly() override                     { return true; }
+};
+
+inline IRdelayAwaiter irDelay(uint32_t _ms)
+{
+    return IRdelayAwaiter(_ms);
+}
+
+//Resumes with true (and a copy in _message) for the first packet from _rx that _filter accepts,
+//or with false after _timeoutMs.
+template <class FILTER>
+class IRpacketAwaiter : public IRwaiter {
+  public:
+    IRpacketAwaiter(ESP32_IRrxBase &_rx, FILTER _filter, uint32_t _timeoutMs, LttoMessage &_message)
+        : rx(&_rx), filter(_filter), message(_message)  { waitUs = (int64_t)_timeoutMs * 1000; }
+
+    bool    offerPacket(ESP32_IRrxBase *_from, const LttoMessage &_packet) override
+    {
+        if(_from != rx || !filter(_packet)) return false;
+        message = _packet;
+        return true;
+    }
+
+  private:
+    ESP32_IRrxBase     *rx;
+    FILTER              filter;
+    LttoMessage        &message;
+};
+
+template <class FILTER>
+IRpacketAwaiter<FILTER> irReceivePacket(ESP32_IRrxBase &_rx, FILTER _filter, uint32_t _timeoutMs, LttoMessage &_message)
+{
+    return IRpacketAwaiter<FILTER>(_rx, _filter, _timeoutMs, _message);
+}
+
+//Same, for whole hosting messages. Repeats of a message are offered too, as a retry is
+//often exactly what a handshake is waiting for.
+template <class FILTER>
+class IRmessageAwaiter : public IRwaiter {
+  public:
+    IRmessageAwaiter(ESP32_IRrxBase &_rx, FILTER _filter, uint32_t _timeoutMs, LttoHostMessage &_message)
+        : rx(&_rx), filter(_filter), message(_message)  { waitUs = (int64_t)_timeoutMs * 1000; }
+
+    bool    offerMessage(ESP32_IRrxBase *_from, const LttoHostMessage &_hostMessage) override
+    {
+        if(_from != rx || !filter(_hostMessage))    return false;
+        message = _hostMessage;
+        return true;
+    }
+
+  private:
+    ESP32_IRrxBase     *rx;
+    FILTER              filter;
+    LttoHostMessage    &message;
+};
+
+template <class FILTER>
+IRmessageAwaiter<FILTER> irReceiveMessage(ESP32_IRrxBase &_rx, FILTER _filter, uint32_t _timeoutMs, LttoHostMessage &_message)
+{
+    return IRmessageAwaiter<FILTER>(_rx, _filter, _timeoutMs, _message);
+}
+
+#endif /* __cpp_impl_coroutine */
+
+#endif /* ESP32_IR_CORO_H_ */
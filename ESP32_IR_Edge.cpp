@@ -0,0 +1,330 @@
+ /* Copyright (c) 2018 Richie Mickan. All Rights Reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>. *
+ */
+
+#include "Arduino.h"
+#include "ESP32_IR_Edge.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "esp_cpu.h"
+
+#ifdef __cplusplus
+}
+#endif
+
+////////////////////////////////////
+#define         DEBUG       false
+////////////////////////////////////
+
+#define EDGE_QUEUE_MASK     (EDGE_QUEUE_SIZE - 1)
+
+ESP32_IRedgeCapture    *ESP32_IRedgeCapture::startedCaptures[MAX_EDGE_CAPTURES];
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+ESP32_IRedgeCapture::ESP32_IRedgeCapture()
+{
+    sensorCount     = 0;
+    started         = false;
+    manualClock     = false;
+    manualTime      = 0;
+    statsSince      = now();
+    statsMux        = portMUX_INITIALIZER_UNLOCKED;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+ESP32_IRedgeCapture::~ESP32_IRedgeCapture()
+{
+    end();
+    for(int index = 0; index < sensorCount; index++)    delete sensors[index];
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+int ESP32_IRedgeCapture::addSensor(int _pin)
+{
+    if(sensorCount >= MAX_EDGE_SENSORS || started) return -1;
+
+    //Each sensor is ~1.3K, so only the ones in use are allocated.
+    EdgeSensor *_new = new EdgeSensor;
+    memset(_new, 0, sizeof(EdgeSensor));
+    sensors[sensorCount] = _new;
+
+    EdgeSensor &_sensor = *_new;
+    _sensor.capture     = this;
+    _sensor.pin         = _pin;
+    _sensor.level       = 1;
+    return sensorCount++;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRedgeCapture::begin()
+{
+    if(started) return;
+    for(int index = 0; index < sensorCount; index++)
+    {
+        if(sensors[index]->pin < 0)  continue;
+        gpio_pullup_en((gpio_num_t)sensors[index]->pin);
+        attachInterruptArg(sensors[index]->pin, edgeISR, sensors[index], CHANGE);
+    }
+    for(int index = 0; index < MAX_EDGE_CAPTURES; index++)
+    {
+        if(startedCaptures[index] != NULL)  continue;
+        startedCaptures[index] = this;
+        break;
+    }
+    started = true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRedgeCapture::end()
+{
+    if(!started)    return;
+    for(int index = 0; index < sensorCount; index++)
+    {
+        if(sensors[index]->pin >= 0) detachInterrupt(sensors[index]->pin);
+    }
+    for(int index = 0; index < MAX_EDGE_CAPTURES; index++)
+    {
+        if(startedCaptures[index] == this)  startedCaptures[index] = NULL;
+    }
+    started = false;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+int64_t ESP32_IRedgeCapture::now()
+{
+    if(manualClock) return manualTime;
+    return esp_timer_get_time();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void IRAM_ATTR ESP32_IRedgeCapture::edgeISR(void *_arg)
+{
+    uint32_t    _cycles = esp_cpu_get_cycle_count();
+    EdgeSensor *_sensor = (EdgeSensor *)_arg;
+
+    pushEdge(_sensor, (uint32_t)esp_timer_get_time(), gpio_get_level((gpio_num_t)_sensor->pin));
+
+    //64 bits can't be written in one store, so a reader on the other core could see half an update.
+    portENTER_CRITICAL_ISR(&_sensor->capture->statsMux);
+    _sensor->isrCycles += esp_cpu_get_cycle_count() - _cycles;
+    portEXIT_CRITICAL_ISR(&_sensor->capture->statsMux);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//Single producer (the sensor's ISR, or feedEdge()), single consumer (receive()).
+void IRAM_ATTR ESP32_IRedgeCapture::pushEdge(EdgeSensor *_sensor, uint32_t _timeUs, uint8_t _level)
+{
+    uint16_t _head = _sensor->head;
+    uint16_t _next = (_head + 1) & EDGE_QUEUE_MASK;
+    _sensor->edges++;
+    _sensor->level = _level;
+
+    if(_next == _sensor->tail)
+    {
+        _sensor->droppedEdges++;
+        _sensor->lost = true;
+        return;
+    }
+    _sensor->queue[_head].timeUs    = _timeUs;
+    _sensor->queue[_head].level     = _level | (_sensor->lost ? EDGE_LOST : 0);
+    _sensor->head                   = _next;
+    _sensor->lost                   = false;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+bool ESP32_IRedgeCapture::carrierSensed()
+{
+    for(int index = 0; index < sensorCount; index++)
+    {
+        if(sensors[index]->level == 0)  return true;
+    }
+    return false;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+bool ESP32_IRedgeCapture::anyCarrierSensed()
+{
+    for(int index = 0; index < MAX_EDGE_CAPTURES; index++)
+    {
+        if(startedCaptures[index] != NULL && startedCaptures[index]->carrierSensed())   return true;
+    }
+    return false;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRedgeCapture::feedEdge(int _sensor, int _level, int64_t _timeUs)
+{
+    if(_sensor < 0 || _sensor >= sensorCount)   return;
+    pushEdge(sensors[_sensor], (uint32_t)_timeUs, _level ? 1 : 0);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRedgeCapture::setTime(int64_t _timeUs)
+{
+    manualClock = true;
+    manualTime  = _timeUs;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRedgeCapture::finishItem(EdgeSensor &_sensor, uint32_t _space)
+{
+    _sensor.markPending = false;
+    if(_sensor.burstItems >= EDGE_MAX_BURST_ITEMS)  return;     //as the RMT, the rest of a long burst is lost
+
+    uint32_t _mark = _sensor.markEnd - _sensor.markStart;
+    rmt_item32_t &_item = _sensor.burst[_sensor.burstItems++];
+    _item.duration0 = (_mark  > 32767) ? 32767 : _mark;
+    _item.level0    = 0;
+    _item.duration1 = (_space > 32767) ? 32767 : _space;
+    _item.level1    = 1;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//Turns queued edges into items until a gap of RX_IDLE_US ends the burst (or, with no more edges,
+//RX_IDLE_US has passed since the last one). A partly received burst is kept for the next call.
+int ESP32_IRedgeCapture::receive(int _sensor, rmt_item32_t **_items, int64_t *_lastEdgeTime)
+{
+    if(_sensor < 0 || _sensor >= sensorCount)   return 0;
+
+    uint32_t    _cycles     = esp_cpu_get_cycle_count();
+    EdgeSensor &_state      = *sensors[_sensor];
+    int64_t     _now        = now();
+    bool        _complete   = false;
+
+    while(_state.tail != _state.head)
+    {
+        EdgeEvent &_edge = _state.queue[_state.tail];
+        uint8_t    _level = _edge.level & ~EDGE_LOST;
+
+        //Edges are missing before this one, so the burst so far can't be trusted - a mark whose end
+        //was dropped would otherwise never end, and swallow the next burst.
+        if(_edge.level & EDGE_LOST)
+        {
+            _state.burstItems   = 0;
+            _state.inMark       = false;
+            _state.markPending  = false;
+        }
+
+        if(_level == 0 && !_state.inMark)                   //IR on - a mark starts
+        {
+            if(_state.markPending)
+            {
+                uint32_t _space = _edge.timeUs - _state.markEnd;
+                if(_space >= RX_IDLE_US)
+                {
+                    _complete = true;                       //this edge starts the next burst
+                    break;
+                }
+                finishItem(_state, _space);
+            }
+            _state.inMark       = true;
+            _state.markStart    = _edge.timeUs;
+        }
+        else if(_level != 0 && _state.inMark)               //IR off - the mark ends
+        {
+            _state.inMark       = false;
+            _state.markPending  = true;
+            _state.markEnd      = _edge.timeUs;
+        }
+        //else a repeated level (an edge was missed), skip it
+
+        _state.tail = (_state.tail + 1) & EDGE_QUEUE_MASK;
+    }
+
+    if(!_complete && _state.markPending && (uint32_t)((uint32_t)_now - _state.markEnd) >= RX_IDLE_US)   _complete = true;
+
+    int _numItems = 0;
+    if(_complete)
+    {
+        finishItem(_state, 0);
+        _numItems = _state.burstItems;
+        _state.burstItems = 0;
+        _state.bursts++;
+
+        *_items = _state.burst;
+        if(_lastEdgeTime != NULL)   *_lastEdgeTime = _now - (uint32_t)((uint32_t)_now - _state.markEnd);
+    }
+
+    //Polling for a burst costs as much as assembling one, so every call is counted.
+    _state.receiveCalls++;
+    _state.assembleCycles += esp_cpu_get_cycle_count() - _cycles;
+    return _numItems;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+int ESP32_IRedgeCapture::readSensorCount()
+{
+    return sensorCount;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+EdgeSensorStats ESP32_IRedgeCapture::readSensorStats(int _sensor)
+{
+    EdgeSensorStats _stats = {0, 0, 0, 0, 0, 0, 0, 0};
+    if(_sensor < 0 || _sensor >= sensorCount)   return _stats;
+
+    EdgeSensor &_state          = *sensors[_sensor];
+    portENTER_CRITICAL(&statsMux);
+    uint64_t    _isrCycles      = _state.isrCycles;
+    portEXIT_CRITICAL(&statsMux);
+    uint64_t    _cycles         = _isrCycles + _state.assembleCycles;
+    int64_t     _elapsed        = now() - statsSince;
+
+    _stats.edges                = _state.edges;
+    _stats.droppedEdges         = _state.droppedEdges;
+    _stats.bursts               = _state.bursts;
+    _stats.receiveCalls         = _state.receiveCalls;
+    _stats.isrCyclesAvg         = _state.edges        ? _isrCycles / _state.edges : 0;
+    _stats.assembleCyclesAvg    = _state.receiveCalls ? _state.assembleCycles / _state.receiveCalls : 0;
+    _stats.cyclesPerBurst       = _state.bursts       ? _cycles / _state.bursts : 0;
+    _stats.cyclesPerSecond      = (_elapsed > 0)      ? _cycles * 1000000 / _elapsed : 0;
+    return _stats;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRedgeCapture::clearSensorStats()
+{
+    for(int index = 0; index < sensorCount; index++)
+    {
+        sensors[index]->edges           = 0;
+        sensors[index]->droppedEdges    = 0;
+        sensors[index]->bursts          = 0;
+        sensors[index]->receiveCalls    = 0;
+        sensors[index]->assembleCycles  = 0;
+        portENTER_CRITICAL(&statsMux);
+        sensors[index]->isrCycles       = 0;
+        portEXIT_CRITICAL(&statsMux);
+    }
+    statsSince = now();
+}
@@ -0,0 +1,128 @@
+ /* Copyright (c) 2018 Richie Mickan. All Rights Reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>. *
+ */
+
+/* A receiver backend that doesn't use an RMT channel.
+ * Each sensor pin gets an any-edge interrupt that timestamps the edge into a small per-sensor queue.
+ * The edges are turned into rmt_item32_t bursts (mark/space, split at RX_IDLE_US of quiet) when an
+ * ESP32_IRrx<> attached to the sensor asks for one, so all the decoders work unchanged.
+ * One ESP32_IRedgeCapture handles up to MAX_EDGE_SENSORS pins, leaving the RMT channels for Tx.
+ *
+ *  ESP32_IRedgeCapture     sensors;
+ *  ESP32_IRrx<>            hull[12];
+ *  for(int n = 0; n < 12; n++) hull[n].attachEdgeCapture(&sensors, sensors.addSensor(pins[n]));
+ *  sensors.begin();
+ *
+ * feedEdge() / setTime() inject edges and time, to run the same path without the hardware.
+ */
+
+#ifndef ESP32_IR_EDGE_H_
+#define ESP32_IR_EDGE_H_
+
+#include "ESP32_IR_LTTO.h"
+
+#define MAX_EDGE_SENSORS        16
+#define MAX_EDGE_CAPTURES       4       //started captures that listen-before-talk carrier sense reads
+#define EDGE_QUEUE_SIZE         128     //edges per sensor waiting to be assembled (power of 2)
+#define EDGE_MAX_BURST_ITEMS    64      //same as one RMT memory block
+#define EDGE_LOST               0x80    //EdgeEvent level flag - the queue was full, edges before this one are missing
+
+struct EdgeEvent
+{
+    uint32_t    timeUs;                 //low 32 bits of esp_timer (wraps after 71 minutes)
+    uint8_t     level;                  //| EDGE_LOST
+};
+
+struct EdgeSensorStats
+{
+    uint32_t    edges;
+    uint32_t    droppedEdges;           //queue was full
+    uint32_t    bursts;
+    uint32_t    receiveCalls;
+    uint32_t    isrCyclesAvg;           //CPU cycles per edge interrupt
+    uint32_t    assembleCyclesAvg;      //CPU cycles per receive() call, whether it finished a burst or not
+    uint32_t    cyclesPerBurst;         //both, per burst received
+    uint32_t    cyclesPerSecond;        //both, since clearSensorStats() - over the CPU clock, the sensor's load
+};
+
+class ESP32_IRedgeCapture;
+
+struct EdgeSensor
+{
+    ESP32_IRedgeCapture    *capture;
+    int                     pin;
+    EdgeEvent               queue[EDGE_QUEUE_SIZE];     //written by the ISR, read by receive()
+    volatile uint16_t       head;
+    volatile uint16_t       tail;
+    volatile uint8_t        level;                      //of the last edge, 0 = IR present
+    bool                    lost;                       //edges dropped since the last one queued
+
+    //burst being assembled
+    rmt_item32_t            burst[EDGE_MAX_BURST_ITEMS];
+    int                     burstItems;
+    bool                    inMark;
+    bool                    markPending;                //a finished mark waiting for its space
+    uint32_t                markStart;
+    uint32_t                markEnd;
+
+    uint32_t                edges;
+    uint32_t                droppedEdges;
+    uint32_t                bursts;
+    uint32_t                receiveCalls;
+    uint64_t                isrCycles;                  //written by the ISR, read under statsMux
+    uint64_t                assembleCycles;             //every receive() call
+};
+
+class ESP32_IRedgeCapture {
+  public:
+    ESP32_IRedgeCapture();
+    ~ESP32_IRedgeCapture();
+
+    int         addSensor(int _pin);            //sensor number, or -1
+    void        begin();                        //attach the pin interrupts
+    void        end();
+
+    int         receive(int _sensor, rmt_item32_t **_items, int64_t *_lastEdgeTime = NULL);
+    int64_t     now();
+
+    //Carrier sense for listen-before-talk - a sensor's last edge left it seeing IR
+    bool        carrierSensed();
+    static bool anyCarrierSensed();                     //any started capture
+
+    //Host-side input: edges (level as read from the IR receiver, 0 = IR present) and time.
+    //Once setTime() has been called the capture runs on that clock instead of esp_timer.
+    void        feedEdge(int _sensor, int _level, int64_t _timeUs);
+    void        setTime(int64_t _timeUs);
+
+    int                 readSensorCount();
+    EdgeSensorStats     readSensorStats(int _sensor);
+    void                clearSensorStats();
+
+  private:
+    EdgeSensor     *sensors[MAX_EDGE_SENSORS];     //allocated by addSensor()
+    int             sensorCount;
+    portMUX_TYPE    statsMux;
+    bool            started;
+    bool            manualClock;
+    int64_t         manualTime;
+    int64_t         statsSince;
+
+    static ESP32_IRedgeCapture *startedCaptures[MAX_EDGE_CAPTURES];
+
+    static void     edgeISR(void *_arg);
+    static void     pushEdge(EdgeSensor *_sensor, uint32_t _timeUs, uint8_t _level);
+    void            finishItem(EdgeSensor &_sensor, uint32_t _space);
+};
+
+#endif /* ESP32_IR_EDGE_H_ */
@@ -41,31 +41,18 @@ extern "C" {
 #endif
 
 #include "ESP32_IR_LTTO.h"
+#include "ESP32_IR_Sim.h"
+#include "ESP32_IR_Roster.h"
+#include "ESP32_IR_Edge.h"
 
 ////////////////////////////////////
 #define         DEBUG       false
 ////////////////////////////////////
 
-#define PRE_SYNC_MARK        3000
-#define PRE_SYNC_SPACE       6000
-#define BEACON_HEADER        6000
-#define TAG_PACKET_HEADER    3000
-#define MARK_SPACE           2000
-#define ZERO_BIT             1000
-#define ONE_BIT              2000
-#define INTERPACKET_DEFAULT 25000
-#define INTERPACKET_TAG     56000
-#define INTERPACKET_CSUM    80000
-#define VARIATION             .20   // 20%
-
-#define BEACON_BIT_COUNT            5
-#define LTAR_BEACON_BIT_COUNT       9
-#define TAG_BIT_COUNT               7
-#define PACKET_BIT_COUNT            9
-#define DATA_BIT_COUNT              8
-#define CHECKSUM_BIT_COUNT          9
-#define CHECKSUM_BIT_SET            256
-
+#define BRX_START            2000
+#define BRX_SPACE             500
+#define BRX_ONE              1000
+#define BRX_ZERO              500
 
 #define ROUND_TO                1   //50          //rounding value for microseconds timings
 #define MARK_EXCESS             0   //100         //tweeked to get the right timing
@@ -79,9 +66,21 @@ extern "C" {
 #define TAG                     'T'
 #define BEACON                  'Z'
 #define LTAR_BEACON             'E'
+#define BRX                     'B'
 #define BCD                     true
 #define LTAR                    true
 
+//Tx frame kinds, cached or held for listen-before-talk
+#define FRAME_ANNOUNCE          1
+#define FRAME_ASSIGN            2
+#define FRAME_ASSIGN_FAILED     3
+#define FRAME_JOIN              4
+
+//Listen-before-talk states
+#define LBT_IDLE                0
+#define LBT_HOLDING             1
+#define LBT_WATCHING            2
+
 
 // Clock divisor (base clock is 80MHz)
 #define CLK_DIV                 80
@@ -89,7 +88,85 @@ extern "C" {
 // Number of clock ticks that represent 10us.  10 us = 1/100th msec.
 #define TICK_10_US              (80000000 / CLK_DIV / 100000) // = 10
 
-static RingbufHandle_t          ringBuf;
+//Self-echo (IFF) suppression.
+//Every packet any Tx instance sends is logged here with the time it is on air. A receiver that has
+//setEchoSuppression(true) drops a packet that matches one of ours, if it arrives within
+//ECHO_WINDOW_US of that packet finishing. Shared by all instances, as they are all co-located.
+
+#define ECHO_HISTORY_SIZE   32
+#define ECHO_WINDOW_US      100000      //RMT idle threshold + time for the sketch to poll readIR()
+
+struct EchoRecord
+{
+    uint32_t    key;
+    int64_t     startTime;
+    int64_t     endTime;
+};
+
+static EchoRecord       echoHistory[ECHO_HISTORY_SIZE];
+static int              echoHistoryIndex    = 0;
+static portMUX_TYPE     echoMux             = portMUX_INITIALIZER_UNLOCKED;
+
+static uint32_t echoKey(char _type, uint16_t _data)
+{
+    return ((uint32_t)(uint8_t)_type << 16) | _data;
+}
+
+static void recordEcho(uint32_t _key, int64_t _startTime, int64_t _endTime)
+{
+    portENTER_CRITICAL(&echoMux);
+    echoHistory[echoHistoryIndex].key       = _key;
+    echoHistory[echoHistoryIndex].startTime = _startTime;
+    echoHistory[echoHistoryIndex].endTime   = _endTime + ECHO_WINDOW_US;
+    echoHistoryIndex = (echoHistoryIndex + 1) % ECHO_HISTORY_SIZE;
+    portEXIT_CRITICAL(&echoMux);
+}
+
+static bool matchEcho(uint32_t _key, int64_t _rxTime)
+{
+    bool _match = false;
+    portENTER_CRITICAL(&echoMux);
+    for(int index = 0; index < ECHO_HISTORY_SIZE; index++)
+    {
+        if(echoHistory[index].key == _key
+           && _rxTime >= echoHistory[index].startTime && _rxTime <= echoHistory[index].endTime)
+        {
+            _match = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&echoMux);
+    return _match;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//Protocol registry.
+//Every protocol starts with a distinctive sync mark/space, so the first item of a burst picks the
+//parser straight from a table indexed by (mark, space) in DISPATCH_BUCKET_US steps - no trial decoding.
+//LTAR shares the LTTO pre-sync and headers (it is told apart by bit count), so the LTTO parser covers both.
+
+#define DISPATCH_BUCKET_US      500
+#define DISPATCH_BUCKETS        16          //covers 0 - 8mS
+#define MAX_IR_PROTOCOLS        8
+
+static const IRprotocol     lttoProtocol    = { "LTTO", PRE_SYNC_MARK, PRE_SYNC_SPACE, ESP32_IRrxBase::parseLTTO, ZERO_BIT, MARK_SPACE };
+static const IRprotocol     brxProtocol     = { "BRX",  BRX_START,     BRX_SPACE,      ESP32_IRrxBase::parseBRX,  BRX_ZERO, BRX_SPACE  };
+
+static const IRprotocol    *protocols[MAX_IR_PROTOCOLS];
+static int                  protocolCount   = 0;
+static uint8_t              protocolDispatch[DISPATCH_BUCKETS][DISPATCH_BUCKETS];      //index into protocols[] + 1, 0 = none
+
+static int dispatchBucket(unsigned int _duration)
+{
+    return _duration / DISPATCH_BUCKET_US;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+int         ESP32_IRrxBase::rxPins[RMT_CHANNEL_MAX];
+bool        ESP32_IRrxBase::rxPinInstalled[RMT_CHANNEL_MAX];
+int64_t     ESP32_IRrxBase::lastCollisionTime           = 0;
 
 //////////////////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -102,7 +179,115 @@ ESP32_IR::ESP32_IR()
 
 //////////////////////////////////////////////////////////////////////////////////////////
 
-bool ESP32_IR::ESP32_IRrxPIN(int _rxPin, int _channel)
+void ESP32_IR::stopIR()
+{
+    //Only the role that was initialised is installed, the other one does nothing.
+    ESP32_IRtxBase::stopIR();
+    ESP32_IRrxBase::stopIR();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IR::attachMedium(ESP32_IRmedium *_medium, int _node)
+{
+    ESP32_IRtxBase::attachMedium(_medium, _node);
+    ESP32_IRrxBase::attachMedium(_medium, _node);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+ESP32_IRrxBase::ESP32_IRrxBase(size_t _ringBufferSize)
+{
+    gpioNum             = -1;
+    rmtPort             = -1;
+    rxInstalled         = false;
+    ringBufferSize      = _ringBufferSize;
+    ringBuf             = NULL;
+    echoSuppression     = false;
+    echoSuppressedCount = 0;
+    lastRxCollision     = false;
+    collisionCount      = 0;
+    medium              = NULL;
+    mediumNode          = 0;
+    edgeCapture         = NULL;
+    edgeSensor          = 0;
+    latencyTracing      = false;
+    lastEdge            = 0;
+    firstEdge           = 0;
+    burstEndHead        = 0;
+    burstEndCount       = 0;
+    edgeMux             = portMUX_INITIALIZER_UNLOCKED;
+    lttoMessage         = LttoMessage();
+    clearLatency();
+    clearSignalQuality();
+    shedWatermark       = RX_SHED_WATERMARK;
+    overloaded          = false;
+    nearlyFull          = false;
+    lastMessageType     = ' ';
+    lastMessageData     = 0;
+    lastMessageTime     = 0;
+    clearOverloadCounters();
+    glitchGapUs         = RX_GLITCH_GAP_US;
+    glitchMarkUs        = RX_GLITCH_MARK_US;
+    clearGlitchCounters();
+    memset(&hostMessage, 0, sizeof(hostMessage));
+    memset(messageCache, 0, sizeof(messageCache));
+    hostMessageOpen     = false;
+    hostMessageNew      = false;
+    hostMessageRepeated = false;
+    messageCacheWindowMs = MESSAGE_CACHE_MS;
+    clearMessageCacheCounters();
+
+    if(protocolCount == 0)
+    {
+        registerProtocol(&lttoProtocol);
+        registerProtocol(&brxProtocol);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+ESP32_IRtxBase::ESP32_IRtxBase(uint8_t *_frameStorage, int _frameSymbols, int _frameCount,
+                               TxFrameCacheEntry *_cacheEntries, uint8_t *_cacheSymbols, int _cacheSize)
+{
+    if(DEBUG)   Serial.print("ESP32_IRtx::Constructing");
+    txFrames            = _frameStorage;
+    txFrameSymbols      = _frameSymbols;
+    txFrameCount        = _frameCount;
+    txFrameIndex        = 0;
+    irDataArray         = txFrames;
+    arrayIndex          = 0;
+    gpioNum             = -1;
+    rmtPort             = -1;
+    txInstalled         = false;
+    framePacketCount    = 0;
+    txBusyUntil         = 0;
+    listenBeforeTalk    = false;
+    lbtMaxWaitMs        = LBT_MAX_WAIT_MS;
+    contentionWindow    = LBT_MIN_WINDOW;
+    lastContendedSend   = 0;
+    lbtState            = LBT_IDLE;
+    lbtResult           = LBT_SENT;
+    lbtReplaying        = false;
+    medium              = NULL;
+    mediumNode          = 0;
+    activeBeaconFrame   = 0;
+    beaconTimer         = NULL;
+    beaconIsLtar        = false;
+    beaconTagPower      = 0;
+    txLock              = xSemaphoreCreateMutexStatic(&txLockBuffer);
+    lastFrameAirtime    = 0;
+    frameCache          = _cacheEntries;
+    frameCacheSymbols   = _cacheSymbols;
+    frameCacheSize      = _cacheSize;
+    frameCacheEnabled   = false;
+    clearFrameCache();
+    clearFrameCacheCounters();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+bool ESP32_IRrxBase::ESP32_IRrxPIN(int _rxPin, int _channel)
 {
     bool _status = true;
 
@@ -118,7 +303,7 @@ bool ESP32_IR::ESP32_IRrxPIN(int _rxPin, int _channel)
 
 //////////////////////////////////////////////////////////////////////////////////////////
 
-bool ESP32_IR::ESP32_IRtxPIN(int _txPin, int _channel)
+bool ESP32_IRtxBase::ESP32_IRtxPIN(int _txPin, int _channel)
 {
     bool _status = true;
 
@@ -134,7 +319,7 @@ bool ESP32_IR::ESP32_IRtxPIN(int _txPin, int _channel)
 
 //////////////////////////////////////////////////////////////////////////////////////////
 
-void ESP32_IR::initReceive()
+void ESP32_IRrxBase::initReceive()
 {
     rmt_config_t config;
     config.rmt_mode = RMT_MODE_RX;
@@ -144,17 +329,21 @@ void ESP32_IR::initReceive()
     config.mem_block_num = 1; //how many memory blocks 64 x N (0-7)
     config.rx_config.filter_en = 1;
     config.rx_config.filter_ticks_thresh = 100; // 80000000/100 -> 800000 / 100 = 8000  = 125us
-    config.rx_config.idle_threshold = TICK_10_US * 100 * 8;      // 8mS
+    config.rx_config.idle_threshold = RX_IDLE_US / 10 * TICK_10_US;     // 8mS
     config.clk_div = CLK_DIV;
     ESP_ERROR_CHECK(rmt_config(&config));
-    ESP_ERROR_CHECK(rmt_driver_install(config.channel, 1000, 0));
+    ESP_ERROR_CHECK(rmt_driver_install(config.channel, ringBufferSize, 0));
     rmt_get_ringbuf_handle(config.channel, &ringBuf);
     rmt_rx_start(config.channel, 1);
+    if(latencyTracing)  attachInterruptArg(gpioNum, edgeISR, this, CHANGE);
+    rxInstalled = true;
+    rxPins[rmtPort]         = gpioNum;
+    rxPinInstalled[rmtPort] = true;
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////
 
-void ESP32_IR::initTransmit()
+void ESP32_IRtxBase::initTransmit()
 {
   rmt_config_t config;
   config.channel = (rmt_channel_t)rmtPort;
@@ -171,16 +360,32 @@ void ESP32_IR::initTransmit()
   config.rmt_mode = (rmt_mode_t)0;//RMT_MODE_TX;
   rmt_config(&config);
   rmt_driver_install(config.channel, 0, 0);//19     /*!< RMT interrupt number, select from soc.h */
+  rmt_translator_init(config.channel, lttoSymbolTranslator);
+  txInstalled = true;
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////
 
-void ESP32_IR::sendIR(rmt_item32_t data[], int IRlength, bool waitTilDone)
+void ESP32_IRtxBase::sendIR(rmt_item32_t data[], int IRlength, bool waitTilDone)
 {
     if(DEBUG)   Serial.println("ESP32_IR::sendIR()");
+    if(medium != NULL)
+    {
+        int64_t _startTime = txTime();
+        if(txBusyUntil > _startTime)    _startTime = txBusyUntil;
+        medium->transmitItems(mediumNode, data, IRlength, _startTime);
+        for(int index = 0; index < IRlength && data[index].duration0 != 0; index++)
+        {
+            _startTime += data[index].duration0 + data[index].duration1;
+        }
+        txBusyUntil = _startTime;
+        return;
+    }
     rmt_config_t config;
     config.channel = (rmt_channel_t)rmtPort;
+    xSemaphoreTake(txLock, portMAX_DELAY);
     rmt_write_items(config.channel, data, IRlength, waitTilDone);  //false means non-blocking
+    xSemaphoreGive(txLock);
     //Wait until sending is done.
     if(waitTilDone)
     {
@@ -192,7 +397,7 @@ void ESP32_IR::sendIR(rmt_item32_t data[], int IRlength, bool waitTilDone)
 
 //////////////////////////////////////////////////////////////////////////////////////////
 
-void ESP32_IR::sendLttoIR(String _fullDataString)
+void ESP32_IRtxBase::sendLttoIR(String _fullDataString)
 {
     int _delimiterPosition  = 0;
 
@@ -213,12 +418,12 @@ void ESP32_IR::sendLttoIR(String _fullDataString)
         encodeLTTO(_packetType, _data);
     }
     //send the data
-    sendIR(irDataArray, sizeof(irDataArray) );
+    sendFrame(irDataArray, txSymbolCount() );
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////
 
-void ESP32_IR::sendLttoIR(char _type, int _data)
+void ESP32_IRtxBase::sendLttoIR(char _type, int _data)
 {
     if(DEBUG)
     {
@@ -229,265 +434,1670 @@ void ESP32_IR::sendLttoIR(char _type, int _data)
 
     clearIRdataArray();
     encodeLTTO(_type, _data);
-    sendIR(irDataArray, sizeof(irDataArray) );
+    sendFrame(irDataArray, txSymbolCount() );
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////
 
-void    ESP32_IR::sendBrxTest()
+void    ESP32_IRtxBase::sendBrxTest()
 {
-    const uint16_t    BRX_START     = 2000;
-    const uint16_t    BRX_SPACE     =  500;
-    const uint16_t    BRX_ONE       = 1000;
-    const uint16_t    BRX_ZERO      =  500;
-
     clearIRdataArray();
 
     //Create MAB
-    irDataArray[0].duration0 = BRX_START;
-    irDataArray[0].level0    = 1;
-    irDataArray[0].duration1 = BRX_SPACE;
-    irDataArray[0].level1    = 0;
+    putSymbol(irDataArray, arrayIndex, SYM_BRX_START);
+    int _packetTime = BRX_START + BRX_SPACE;
 
     for(int index = 1; index < 25; index++)
     {
-        static bool oddEven = true;
-        if (oddEven) irDataArray[index].duration0 = BRX_ONE;
-        else         irDataArray[index].duration0 = BRX_ZERO;
-        oddEven = !oddEven ;
-        irDataArray[index].duration0 = BRX_ONE;
-        irDataArray[index].level0    = 1;
-        irDataArray[index].duration1 = BRX_SPACE;
-        irDataArray[index].level1    = 0;
-    }
-    irDataArray[25].duration0 = BRX_ZERO;
-    irDataArray[25].level0    = 1;
-    irDataArray[25].duration1 = BRX_SPACE;
-    irDataArray[25].level1    = 0;
-
-    sendIR(irDataArray, sizeof(irDataArray) );
+        putSymbol(irDataArray, arrayIndex, SYM_BRX_ONE);
+        _packetTime += BRX_ONE + BRX_SPACE;
+    }
+    putSymbol(irDataArray, arrayIndex, SYM_BRX_ZERO);
+    _packetTime += BRX_ZERO + BRX_SPACE;
+
+    //One packet, so sendFrame() has its airtime like any other frame's
+    framePacketKey[0]   = echoKey(BRX, 0);
+    framePacketTime[0]  = _packetTime;
+    framePacketCount    = 1;
+
+    sendFrame(irDataArray, txSymbolCount() );
     Serial.println("\n----------\nBrx sent\n----------");
 }
 
 
 //////////////////////////////////////////////////////////////////////////////////////////
 
+void ESP32_IRtxBase::sendIR(char type, uint8_t message)
+{
+    sendLttoIR(type, message);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
 
-void ESP32_IR::clearIRdataArray()
+bool ESP32_IRtxBase::sendLTAG(byte tagPower)
 {
-    if(DEBUG)   Serial.println("ESP32_IR::clearIRdataArray");
-    for(int index = 0; index < ARRAY_SIZE; index++)
+    //  6..5    4..2        1..0
+    //  0       0           TagPower        LTAG mode has no teams and no players
+    sendLttoIR(TAG, tagPower & 0x03);
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+bool ESP32_IRtxBase::sendTag(byte teamID, byte playerID, byte tagPower)
+{
+    //  6..5    4..2        1..0
+    //  Team    Player-1    TagPower
+    //Non-blocking, so back to back tags are encoded into the next Tx frame while this one is sent,
+    //and the RMT starts the next one straight after this frame's INTERPACKET_TAG gap.
+    sendLttoIR(TAG, ((teamID & 0x03) << 5) | (((playerID - 1) & 0x07) << 2) | (tagPower & 0x03));
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+bool ESP32_IRtxBase::sendBeacon(bool tagReceived, byte teamID, byte tagPower)
+{
+    sendLttoIR(BEACON, encodeBeaconData(tagReceived, teamID, tagPower));
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+bool ESP32_IRtxBase::sendZoneBeacon(byte zoneType, byte teamID)
+{
+    //  4       3..2    1..0
+    //  1       Team    ZoneType
+    sendLttoIR(BEACON, (1 << 4) | ((teamID & 0x03) << 2) | (zoneType & 0x03));
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+bool ESP32_IRtxBase::sendLTARbeacon(bool tagReceived, bool shieldsActive, byte tagsRemaining, byte unKnown, byte teamID)
+{
+    sendLttoIR(LTAR_BEACON, encodeLTARbeaconData(tagReceived, shieldsActive, tagsRemaining, unKnown, teamID));
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+uint16_t ESP32_IRtxBase::encodeBeaconData(bool _tagReceived, byte _teamID, byte _tagPower)
+{
+    //  4       3..2    1..0
+    //  Tagged  Team    TagPower
+    return (_tagReceived << 4) | ((_teamID & 0x03) << 2) | (_tagPower & 0x03);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+uint16_t ESP32_IRtxBase::encodeLTARbeaconData(bool _tagReceived, bool _shieldsActive, byte _tagsRemaining, byte _unKnown, byte _teamID)
+{
+    //  8       7       6..5            4..2        1..0
+    //  Tagged  Shields TagsRemaining   Unknown     Team
+    return (_tagReceived << 8) | (_shieldsActive << 7) | ((_tagsRemaining & 0x03) << 5)
+         | ((_unKnown & 0x07) << 2) | (_teamID & 0x03);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//The Beacon autopilot keeps two pre-encoded beacon frames and an esp_timer that re-sends
+//the active one, so the sketch never has to call sendBeacon() on a schedule.
+//Updates are encoded into the idle frame and then swapped in, so a beacon in flight is never torn.
+//The frame is < 64 items, so rmt_write_sample() translates it straight into RMT memory and
+//the frame is only read for the duration of that call - which the timer callback makes holding txLock.
+
+bool ESP32_IRtxBase::startBeaconAutopilot(uint16_t _intervalMs, byte teamID, byte tagPower, bool _isLtar)
+{
+    if(DEBUG)   Serial.println("ESP32_IR::startBeaconAutopilot()");
+
+    stopBeaconAutopilot();
+
+    beaconIsLtar        = _isLtar;
+    beaconTagPower      = tagPower;
+    activeBeaconFrame   = 0;
+    encodeBeaconFrame(0, false, false, 0, teamID);
+
+    esp_timer_create_args_t _timerArgs = {};
+    _timerArgs.callback         = &ESP32_IRtxBase::beaconTimerCallback;
+    _timerArgs.arg              = this;
+    _timerArgs.dispatch_method  = ESP_TIMER_TASK;
+    _timerArgs.name             = "IRbeacon";
+
+    if(esp_timer_create(&_timerArgs, &beaconTimer) != ESP_OK)
+    {
+        beaconTimer = NULL;
+        if(DEBUG)   Serial.println("ESP32_IR::startBeaconAutopilot() - timer create failed");
+        return false;
+    }
+    esp_timer_start_periodic(beaconTimer, (uint64_t)_intervalMs * 1000);
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRtxBase::updateBeaconAutopilot(bool tagReceived, bool shieldsActive, byte tagsRemaining, byte teamID)
+{
+    int8_t _idleFrame = 1 - activeBeaconFrame;
+
+    //The last swap was made holding txLock, so no callback can still be reading the idle frame.
+    encodeBeaconFrame(_idleFrame, tagReceived, shieldsActive, tagsRemaining, teamID);
+
+    xSemaphoreTake(txLock, portMAX_DELAY);
+    activeBeaconFrame = _idleFrame;
+    xSemaphoreGive(txLock);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRtxBase::stopBeaconAutopilot()
+{
+    if(beaconTimer == NULL) return;
+
+    esp_timer_stop(beaconTimer);
+    esp_timer_delete(beaconTimer);
+    beaconTimer = NULL;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+bool ESP32_IRtxBase::isBeaconAutopilotRunning()
+{
+    return beaconTimer != NULL;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRtxBase::encodeBeaconFrame(int _frame, bool _tagReceived, bool _shieldsActive, byte _tagsRemaining, byte _teamID)
+{
+    int _symbolCount = 0;
+    memset(beaconFrame[_frame], SYM_END, sizeof(beaconFrame[_frame]));
+
+    char        _type = beaconIsLtar ? LTAR_BEACON : BEACON;
+    uint16_t    _data = beaconIsLtar ? encodeLTARbeaconData(_tagReceived, _shieldsActive, _tagsRemaining, 0, _teamID)
+                                     : encodeBeaconData(_tagReceived, _teamID, beaconTagPower);
+
+    beaconAirtime[_frame]   = encodeLTTO(beaconFrame[_frame], _symbolCount, _type, _data);
+    beaconEchoKey[_frame]   = echoKey(_type, _data);
+
+    beaconSymbolCount[_frame] = _symbolCount + 1;     //include the end marker
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRtxBase::beaconTimerCallback(void *_arg)
+{
+    ESP32_IRtxBase *_ir = (ESP32_IRtxBase*)_arg;
+    rmt_channel_t _channel = (rmt_channel_t)_ir->rmtPort;
+
+    //Skip this beacon rather than stall the esp_timer task if a send is being started, or a tag
+    //is still going out. Holding txLock, nothing else can start between the check and the write.
+    if(xSemaphoreTake(_ir->txLock, 0) != pdTRUE)   return;
+    if(rmt_wait_tx_done(_channel, 0) == ESP_OK)
     {
-        irDataArray[index].duration0 = 0;
-        irDataArray[index].level0    = 0;
-        irDataArray[index].duration1 = 0;
-        irDataArray[index].level1    = 0;
+        int8_t  _frame  = _ir->activeBeaconFrame;
+        int64_t _now    = esp_timer_get_time();
+        recordEcho(_ir->beaconEchoKey[_frame], _now, _now + _ir->beaconAirtime[_frame]);
+        rmt_write_sample(_channel, _ir->beaconFrame[_frame], SYMBOL_BYTES(_ir->beaconSymbolCount[_frame]), false);
     }
+    xSemaphoreGive(_ir->txLock);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+
+//Move on to the next Tx frame before clearing it, so the frame that may still be going out is left alone.
+//The translator reads a frame's symbols from here for as long as it is going out (the ISR refills the
+//RMT memory from them), but rmt_write_sample() waits for the previous transmission to finish before
+//starting the next, so by the time we wrap back around to a frame (txFrameCount sends later) it is done.
+
+void ESP32_IRtxBase::clearIRdataArray()
+{
+    if(DEBUG)   Serial.println("ESP32_IR::clearIRdataArray");
+    txFrameIndex = (txFrameIndex + 1) % txFrameCount;
+    irDataArray  = txFrames + txFrameIndex * SYMBOL_BYTES(txFrameSymbols);
+    memset(irDataArray, SYM_END, SYMBOL_BYTES(txFrameSymbols));
     arrayIndex          = 0;
+    framePacketCount    = 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//Looks for a frame already encoded from the same kind and parameters. On a hit it is copied, with
+//its echo suppression record, into the next Tx frame, ready for sendFrame(). On a miss an entry is
+//set aside, and storeCachedFrame() fills it once the caller has encoded the frame.
+bool ESP32_IRtxBase::loadCachedFrame(uint8_t _kind, const uint8_t *_params, int _paramCount)
+{
+    frameCachePending = -1;
+    if(!frameCacheEnabled || _paramCount > FRAME_CACHE_PARAMS)  return false;
+
+    //FNV-1a
+    uint32_t _hash = 2166136261UL;
+    _hash = (_hash ^ _kind) * 16777619UL;
+    for(int index = 0; index < _paramCount; index++)    _hash = (_hash ^ _params[index]) * 16777619UL;
+    if(_hash == 0)  _hash = 1;
+
+    frameCacheClock++;
+    int _victim = 0;
+    for(int index = 0; index < frameCacheSize; index++)
+    {
+        TxFrameCacheEntry &_entry = frameCache[index];
+        if(_entry.hash == _hash && _entry.kind == _kind && _entry.paramCount == _paramCount
+           && memcmp(_entry.params, _params, _paramCount) == 0)
+        {
+            _entry.lastUsed = frameCacheClock;
+            frameCacheHits++;
+
+            clearIRdataArray();
+            memcpy(irDataArray, frameCacheSymbols + index * SYMBOL_BYTES(txFrameSymbols), SYMBOL_BYTES(txFrameSymbols));
+            arrayIndex          = _entry.symbolCount;
+            calculatedCheckSum  = _entry.checkSum;
+            framePacketCount    = _entry.packetCount;
+            memcpy(framePacketKey,  _entry.packetKey,  sizeof(framePacketKey));
+            memcpy(framePacketTime, _entry.packetTime, sizeof(framePacketTime));
+            return true;
+        }
+        if(_entry.lastUsed < frameCache[_victim].lastUsed)  _victim = index;
+    }
+
+    //Only one game is announced at a time - a changed announce replaces the old one.
+    if(_kind == FRAME_ANNOUNCE)
+    {
+        for(int index = 0; index < frameCacheSize; index++)
+        {
+            if(frameCache[index].hash != 0 && frameCache[index].kind == FRAME_ANNOUNCE) _victim = index;
+        }
+    }
+
+    frameCacheMisses++;
+    TxFrameCacheEntry &_entry = frameCache[_victim];
+    _entry.hash         = 0;            //empty until storeCachedFrame()
+    _entry.kind         = _kind;
+    _entry.paramCount   = _paramCount;
+    memcpy(_entry.params, _params, _paramCount);
+    frameCachePendingHash = _hash;
+    frameCachePending   = _victim;
+    return false;
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRtxBase::storeCachedFrame()
+{
+    if(frameCachePending < 0)   return;
+
+    TxFrameCacheEntry &_entry = frameCache[frameCachePending];
+    memcpy(frameCacheSymbols + frameCachePending * SYMBOL_BYTES(txFrameSymbols), irDataArray, SYMBOL_BYTES(txFrameSymbols));
+    _entry.symbolCount  = arrayIndex;
+    _entry.checkSum     = calculatedCheckSum;
+    _entry.packetCount  = framePacketCount;
+    memcpy(_entry.packetKey,  framePacketKey,  sizeof(framePacketKey));
+    memcpy(_entry.packetTime, framePacketTime, sizeof(framePacketTime));
+    _entry.lastUsed     = frameCacheClock;
+    _entry.hash         = frameCachePendingHash;
+    frameCachePending   = -1;
+}
+
 //////////////////////////////////////////////////////////////////////////////////////////
+
+bool ESP32_IRtxBase::setFrameCache(bool _enabled)
+{
+    frameCacheEnabled = _enabled && frameCacheSize > 0;
+    if(!_enabled)   clearFrameCache();
+    if(_enabled && !frameCacheEnabled)
+    {
+        if(DEBUG)   Serial.println("\nsetFrameCache() - this instance has no FRAME_CACHE_SIZE");
+        return false;
+    }
+    return true;
+}
+
 //////////////////////////////////////////////////////////////////////////////////////////
 
-void ESP32_IR::encodeLTTO(char _type, uint16_t _data)
+void ESP32_IRtxBase::clearFrameCache()
 {
-    int             _syncHeader         = 0;
-    int             _bitCount           = 0;
-    int             _endOfPacketDelay   = 0;
-    bool            _setEndOfPacket     = false;
-    static int      _totalMessageTime   = 0;
+    if(frameCacheSize > 0)  memset(frameCache, 0, frameCacheSize * sizeof(TxFrameCacheEntry));
+    frameCachePending   = -1;
+    frameCacheClock     = 0;
+}
 
-    //calculate the type an set parameters
-    switch (_type)
+//////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t ESP32_IRtxBase::readFrameCacheHits()
+{
+    return frameCacheHits;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t ESP32_IRtxBase::readFrameCacheMisses()
+{
+    return frameCacheMisses;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRtxBase::clearFrameCacheCounters()
+{
+    frameCacheHits      = 0;
+    frameCacheMisses    = 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+int ESP32_IRtxBase::txSymbolCount()
+{
+    //Send up to and including the end marker (the symbol after the last one encoded is always SYM_END).
+    if(arrayIndex >= txFrameSymbols)    return txFrameSymbols;
+    return arrayIndex + 1;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRtxBase::sendFrame(const uint8_t *_symbols, int _symbolCount, bool waitTilDone)
+{
+    if(DEBUG)   Serial.println("ESP32_IR::sendFrame()");
+
+    //The RMT starts this frame once the previous one has finished.
+    int64_t _startTime = txTime();
+    if(txBusyUntil > _startTime)    _startTime = txBusyUntil;
+    int64_t _frameStart = _startTime;
+    for(int index = 0; index < framePacketCount; index++)
     {
-        case TAG:
-            _syncHeader         = TAG_PACKET_HEADER;
-            _bitCount           = TAG_BIT_COUNT;
-            _endOfPacketDelay   = INTERPACKET_TAG;
-            _setEndOfPacket     = true;
-            break;
-        case BEACON:
-            _syncHeader         = BEACON_HEADER;
-            _bitCount           = BEACON_BIT_COUNT;
-            _endOfPacketDelay   = INTERPACKET_DEFAULT;
-            _setEndOfPacket     = true;
-            break;
-        case LTAR_BEACON:
-            _syncHeader         = BEACON_HEADER;
-            _bitCount           = LTAR_BEACON_BIT_COUNT;
-            _endOfPacketDelay   = INTERPACKET_DEFAULT;
-            _setEndOfPacket     = true;
-            break;
-        case PACKET:
-            _syncHeader         = TAG_PACKET_HEADER;
-            _bitCount           = PACKET_BIT_COUNT;
-            _endOfPacketDelay   = INTERPACKET_DEFAULT;
-            calculatedCheckSum  = _data;
-            _totalMessageTime   = 0;
-            break;
-        case DATA:
-            _syncHeader         = TAG_PACKET_HEADER;
-            _bitCount           = DATA_BIT_COUNT;
-            _endOfPacketDelay   = INTERPACKET_DEFAULT;
-            calculatedCheckSum += _data;
-            break;
-        case CHECKSUM:
-            _syncHeader         = TAG_PACKET_HEADER;
-            _bitCount           = CHECKSUM_BIT_COUNT;
-            _endOfPacketDelay   = INTERPACKET_CSUM;
-            _setEndOfPacket     = true;
-            calculatedCheckSum  = calculatedCheckSum % 256;      // CheckSum is the remainder of dividing by 256.
-            calculatedCheckSum  = calculatedCheckSum | 256;      // Set the required 9th MSB bit to 1 to indicate it is a checksum
-            _data = calculatedCheckSum;
-            break;
-        default:
-            if(DEBUG)   Serial.println("ESP32_IR:: ERROR - No match for TYPE:");
-            break;
+        recordEcho(framePacketKey[index], _startTime, _startTime + framePacketTime[index]);
+        _startTime += framePacketTime[index];
+    }
+    txBusyUntil         = _startTime;
+    lastFrameAirtime    = _startTime - _frameStart;
+
+    if(medium != NULL)
+    {
+        medium->transmitSymbols(mediumNode, _symbols, _symbolCount, _frameStart);
+        return;
+    }
+
+    //The translator registered in initTransmit() expands the symbols as the RMT needs them.
+    xSemaphoreTake(txLock, portMAX_DELAY);
+    rmt_write_sample((rmt_channel_t)rmtPort, _symbols, SYMBOL_BYTES(_symbolCount), waitTilDone);
+    xSemaphoreGive(txLock);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+int ESP32_IRtxBase::readLastFrameAirtime()
+{
+    return lastFrameAirtime;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+int64_t ESP32_IRtxBase::txTime()
+{
+    if(medium != NULL)  return medium->now();
+    return esp_timer_get_time();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+int64_t ESP32_IRtxBase::readTxDoneTime()
+{
+    int64_t _now = txTime();
+    return (txBusyUntil > _now) ? txBusyUntil : _now;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRtxBase::attachMedium(ESP32_IRmedium *_medium, int _node)
+{
+    medium      = _medium;
+    mediumNode  = _node;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRtxBase::setListenBeforeTalk(bool _enabled, uint16_t _maxWaitMs)
+{
+    listenBeforeTalk    = _enabled;
+    lbtMaxWaitMs        = _maxWaitMs;
+    if(!_enabled)   cancelListenBeforeTalk();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+bool ESP32_IRtxBase::isListenBeforeTalkPending()
+{
+    return lbtState == LBT_HOLDING;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRtxBase::cancelListenBeforeTalk()
+{
+    if(lbtState == LBT_HOLDING) lbtResult = LBT_BUSY;
+    lbtState = LBT_IDLE;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//Listen before talk, with randomised binary exponential backoff.
+//The frame is held as the parameters it is encoded from, and pollListenBeforeTalk() sends it.
+int ESP32_IRtxBase::holdForClearChannel(uint8_t _kind, const uint8_t *_params, int _paramCount)
+{
+    int64_t _now = txTime();
+
+    if(lbtState == LBT_HOLDING && DEBUG)    Serial.println("ESP32_IR::holdForClearChannel() - replacing the held frame");
+    lbtKind         = _kind;
+    memcpy(lbtParams, _params, _paramCount);
+    lbtRetriesLeft  = LBT_MAX_RETRIES;
+    lbtIdleSince    = _now;
+    lbtGiveUpTime   = _now + (int64_t)lbtMaxWaitMs * 1000;
+    beginContention(_now);
+    lbtState        = LBT_HOLDING;
+    return pollListenBeforeTalk();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//A clear channel is taken at once. Only if our receivers saw a collision since the last contended
+//send do we back off first - the window doubles each time, so a crowd of taggers all replying to
+//the same announce spreads itself out on the next attempt.
+void ESP32_IRtxBase::beginContention(int64_t _now)
+{
+    lbtBackoffUntil = _now;
+    if(collisionSeenSince(lastContendedSend))
+    {
+        contentionWindow *= 2;
+        if(contentionWindow > LBT_MAX_WINDOW)   contentionWindow = LBT_MAX_WINDOW;
+        lbtBackoffUntil += (int64_t)(1 + txRandom() % contentionWindow) * LBT_SLOT_MS * 1000;
+    }
+    else    contentionWindow = LBT_MIN_WINDOW;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//The channel is clear once none of our receivers has seen carrier for LBT_IDLE_MS - longer than the
+//gap between the packets of a message, and than the RX_IDLE_US a receiver waits before it replies, so
+//a held frame lands neither inside a message nor on the reply to it. Carrier starts a backoff of a
+//random number of LBT_SLOT_MS slots, unless one is already running, and the frame goes once both have passed.
+int ESP32_IRtxBase::pollListenBeforeTalk()
+{
+    int64_t _now = txTime();
+
+    if(lbtState == LBT_WATCHING)
+    {
+        if(_now < lbtSentTime + (int64_t)LBT_REPLY_WINDOW_MS * 1000)    return lbtResult;
+
+        if(lbtRetriesLeft == 0 || !collisionSeenSince(lbtSentTime))
+        {
+            lbtState = LBT_IDLE;
+            return lbtResult;
+        }
+        if(DEBUG)   Serial.println("ESP32_IR::pollListenBeforeTalk() - collision after sending, sending again");
+        lbtRetriesLeft--;
+        lbtIdleSince    = _now;
+        lbtGiveUpTime   = _now + (int64_t)lbtMaxWaitMs * 1000;
+        beginContention(_now);
+        lbtState        = LBT_HOLDING;
+    }
+    if(lbtState != LBT_HOLDING) return lbtResult;
+
+    if(txBusyUntil > _now)          lbtIdleSince = txBusyUntil;     //our own frame is still going out
+    else if(channelBusy())
+    {
+        lbtIdleSince = _now;
+        if(lbtBackoffUntil <= _now) lbtBackoffUntil = _now + (int64_t)(1 + txRandom() % contentionWindow) * LBT_SLOT_MS * 1000;
+    }
+
+    if(_now - lbtIdleSince >= LBT_IDLE_MS * 1000 && _now >= lbtBackoffUntil)
+    {
+        sendHeldFrame();
+        lastContendedSend   = _now;
+        lbtSentTime         = _now;
+        lbtResult           = LBT_SENT;
+        lbtState            = (lbtRetriesLeft > 0) ? LBT_WATCHING : LBT_IDLE;
+        return lbtResult;
+    }
+
+    if(_now >= lbtGiveUpTime)
+    {
+        if(DEBUG)   Serial.println("ESP32_IR::pollListenBeforeTalk() - channel busy, not sent");
+        lbtResult   = LBT_BUSY;
+        lbtState    = LBT_IDLE;
+        return lbtResult;
+    }
+    return LBT_PENDING;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRtxBase::sendHeldFrame()
+{
+    const uint8_t *_p = lbtParams;
+
+    lbtReplaying = true;
+    switch(lbtKind)
+    {
+        case FRAME_ANNOUNCE:
+            hostPlayerToGame(0, 0, _p[0], _p[1], _p[2], _p[3], _p[4], _p[5], _p[6], _p[7], _p[8], (int8_t)_p[9]);
+            break;
+        case FRAME_JOIN:
+            taggerRequestToJoin(_p[0], _p[1], _p[2], _p[3]);
+            break;
+    }
+    lbtReplaying = false;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//On a simulated medium, what the receiver on our node hears - otherwise any of our receivers.
+bool ESP32_IRtxBase::channelBusy()
+{
+    if(medium != NULL)  return medium->carrierSensed(mediumNode);
+    return ESP32_IRrxBase::carrierSensed();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+bool ESP32_IRtxBase::collisionSeenSince(int64_t _time)
+{
+    if(medium != NULL)  return medium->collisionSince(mediumNode, _time);
+    return ESP32_IRrxBase::collisionSince(_time);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t ESP32_IRtxBase::txRandom()
+{
+    if(medium != NULL)  return medium->random();
+    return esp_random();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRtxBase::putSymbol(uint8_t *_symbols, int &_index, uint8_t _code)
+{
+    uint8_t &_byte = _symbols[_index / 2];
+    if(_index & 1)  _byte = (_byte & 0x0F) | (_code << 4);
+    else            _byte = (_byte & 0xF0) | (_code & 0x0F);
+    _index++;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//Mark/Space durations for each symbol code. SYM_GAP_CSUM is sent as two of its item.
+static const DRAM_ATTR uint16_t symbolDuration[][2] =
+{
+    {0,                         0},                         //SYM_END
+    {PRE_SYNC_MARK,             PRE_SYNC_SPACE},            //SYM_PRE_SYNC
+    {TAG_PACKET_HEADER,         MARK_SPACE},                //SYM_TAG_HEADER
+    {BEACON_HEADER,             MARK_SPACE},                //SYM_BEACON_HEADER
+    {ZERO_BIT,                  MARK_SPACE},                //SYM_ZERO_BIT
+    {ONE_BIT,                   MARK_SPACE},                //SYM_ONE_BIT
+    {INTERPACKET_DEFAULT/2,     INTERPACKET_DEFAULT/2},     //SYM_GAP_DEFAULT
+    {INTERPACKET_TAG/2,         INTERPACKET_TAG/2},         //SYM_GAP_TAG
+    {INTERPACKET_CSUM/4,        INTERPACKET_CSUM/4},        //SYM_GAP_CSUM
+    {BRX_START,                 BRX_SPACE},                 //SYM_BRX_START
+    {BRX_ONE,                   BRX_SPACE},                 //SYM_BRX_ONE
+    {BRX_ZERO,                  BRX_SPACE},                 //SYM_BRX_ZERO
+};
+#define SYMBOL_CODE_COUNT   (sizeof(symbolDuration) / sizeof(symbolDuration[0]))
+
+static inline int IRAM_ATTR expandSymbol(uint8_t _code, rmt_item32_t *_item)
+{
+    if(_code >= SYMBOL_CODE_COUNT)  _code = SYM_END;
+
+    bool _isMark = (_code != SYM_END) && (_code < SYM_GAP_DEFAULT || _code > SYM_GAP_CSUM);
+    _item->duration0 = symbolDuration[_code][0];
+    _item->level0    = _isMark;
+    _item->duration1 = symbolDuration[_code][1];
+    _item->level1    = 0;
+
+    if(_code != SYM_GAP_CSUM) return 1;
+    _item[1] = _item[0];
+    return 2;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//Host/debug equivalent of the translator - expands a whole symbol frame into RMT items.
+int ESP32_IRtxBase::expandSymbols(const uint8_t *_symbols, int _symbolCount, rmt_item32_t *_items, int _maxItems)
+{
+    int _itemCount = 0;
+    for(int index = 0; index < _symbolCount && _itemCount + 2 <= _maxItems; index++)
+    {
+        uint8_t _code = (index & 1) ? (_symbols[index / 2] >> 4) : (_symbols[index / 2] & 0x0F);
+        _itemCount += expandSymbol(_code, &_items[_itemCount]);
+    }
+    return _itemCount;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//Called by the RMT driver (from rmt_write_sample() and then from its ISR) to refill the RMT memory.
+//Only whole bytes (2 symbols) are consumed, and only when all of their items fit.
+void IRAM_ATTR ESP32_IRtxBase::lttoSymbolTranslator(const void *_src, rmt_item32_t *_dest, size_t _srcSize,
+                                              size_t _wantedNum, size_t *_translatedSize, size_t *_itemNum)
+{
+    const uint8_t  *_symbols    = (const uint8_t*)_src;
+    size_t          _size       = 0;
+    size_t          _num        = 0;
+
+    while(_size < _srcSize && _num + 4 <= _wantedNum)
+    {
+        _num += expandSymbol(_symbols[_size] & 0x0F, &_dest[_num]);
+        _num += expandSymbol(_symbols[_size] >> 4,   &_dest[_num]);
+        _size++;
+    }
+    *_translatedSize    = _size;
+    *_itemNum           = _num;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRtxBase::encodeLTTO(char _type, uint16_t _data)
+{
+    int _packetTime = encodeLTTO(irDataArray, arrayIndex, _type, _data);
+    if(_type == CHECKSUM)   _data = calculatedCheckSum;
+
+    //Remember what is in this frame, so sendFrame() can tell our receivers to ignore the echo.
+    if(framePacketCount < MAX_FRAME_PACKETS)
+    {
+        framePacketKey[framePacketCount]    = echoKey(_type, _data);
+        framePacketTime[framePacketCount]   = _packetTime;
+        framePacketCount++;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+int ESP32_IRtxBase::encodeLTTO(uint8_t *_irDataArray, int &_arrayIndex, char _type, uint16_t _data)
+{
+    int             _syncHeader         = 0;
+    uint8_t         _headerSymbol       = SYM_TAG_HEADER;
+    uint8_t         _gapSymbol          = SYM_GAP_DEFAULT;
+    int             _bitCount           = 0;
+    int             _endOfPacketDelay   = 0;
+    bool            _setEndOfPacket     = false;
+    static int      _totalMessageTime   = 0;
+
+    //calculate the type an set parameters
+    switch (_type)
+    {
+        case TAG:
+            _syncHeader         = TAG_PACKET_HEADER;
+            _bitCount           = TAG_BIT_COUNT;
+            _endOfPacketDelay   = INTERPACKET_TAG;
+            _gapSymbol          = SYM_GAP_TAG;
+            _setEndOfPacket     = true;
+            break;
+        case BEACON:
+            _syncHeader         = BEACON_HEADER;
+            _headerSymbol       = SYM_BEACON_HEADER;
+            _bitCount           = BEACON_BIT_COUNT;
+            _endOfPacketDelay   = INTERPACKET_DEFAULT;
+            _setEndOfPacket     = true;
+            break;
+        case LTAR_BEACON:
+            _syncHeader         = BEACON_HEADER;
+            _headerSymbol       = SYM_BEACON_HEADER;
+            _bitCount           = LTAR_BEACON_BIT_COUNT;
+            _endOfPacketDelay   = INTERPACKET_DEFAULT;
+            _setEndOfPacket     = true;
+            break;
+        case PACKET:
+            _syncHeader         = TAG_PACKET_HEADER;
+            _bitCount           = PACKET_BIT_COUNT;
+            _endOfPacketDelay   = INTERPACKET_DEFAULT;
+            calculatedCheckSum  = _data;
+            _totalMessageTime   = 0;
+            break;
+        case DATA:
+            _syncHeader         = TAG_PACKET_HEADER;
+            _bitCount           = DATA_BIT_COUNT;
+            _endOfPacketDelay   = INTERPACKET_DEFAULT;
+            calculatedCheckSum += _data;
+            break;
+        case CHECKSUM:
+            _syncHeader         = TAG_PACKET_HEADER;
+            _bitCount           = CHECKSUM_BIT_COUNT;
+            _endOfPacketDelay   = INTERPACKET_CSUM;
+            _gapSymbol          = SYM_GAP_CSUM;
+            _setEndOfPacket     = true;
+            calculatedCheckSum  = calculatedCheckSum % 256;      // CheckSum is the remainder of dividing by 256.
+            calculatedCheckSum  = calculatedCheckSum | 256;      // Set the required 9th MSB bit to 1 to indicate it is a checksum
+            _data = calculatedCheckSum;
+            break;
+        default:
+            if(DEBUG)   Serial.println("ESP32_IR:: ERROR - No match for TYPE:");
+            break;
+    }
+
+    if(DEBUG)
+    {
+        Serial.print("\tESP32_IR::encodeLTTO (String) - ");
+        Serial.print(_type);Serial.print(" ");
+        Serial.println(_data);
+    }
+
+    int _packetStartTime = _totalMessageTime;
+
+    //Populate the array
+    //PreSync
+    putSymbol(_irDataArray, _arrayIndex, SYM_PRE_SYNC);
+
+    _totalMessageTime += (PRE_SYNC_MARK + PRE_SYNC_SPACE);
+
+    //Header
+    putSymbol(_irDataArray, _arrayIndex, _headerSymbol);
+
+    _totalMessageTime += (_syncHeader + MARK_SPACE);
+
+    //Data
+    int _dataPulse = 0;
+    _bitCount--;
+
+    while (_bitCount >= 0)
+    {
+        _dataPulse = (bitRead(_data, _bitCount)+1) * 1000;            // the +1 is to convert 0/1 data into 1/2mS pulses.
+
+        putSymbol(_irDataArray, _arrayIndex, bitRead(_data, _bitCount) ? SYM_ONE_BIT : SYM_ZERO_BIT);
+
+        _totalMessageTime += (_dataPulse + MARK_SPACE);
+
+        _bitCount--;
+    }
+
+    //Set the end of data marker
+    putSymbol(_irDataArray, _arrayIndex, _gapSymbol);
+
+    _totalMessageTime += _endOfPacketDelay;
+
+    if(_setEndOfPacket)
+    {
+        //Serial.print("\tESP32_IR::encodeLTTO() - Packet Length = ");Serial.print(_totalMessageTime/1000.0);Serial.println("mS");
+        int _endIndex = _arrayIndex;
+        putSymbol(_irDataArray, _endIndex, SYM_END);
+    }
+    return _totalMessageTime - _packetStartTime;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRrxBase::stopIR()
+{
+    if(!rxInstalled) return;
+    rmt_config_t config;
+    config.channel = (rmt_channel_t)rmtPort;
+    rmt_rx_stop(config.channel);
+    if(DEBUG){
+        Serial.print("ESP32_IR::Uninstalling..");
+    }
+    if(DEBUG){
+        Serial.print("Port : "); Serial.println(config.channel);
+    }
+    rmt_driver_uninstall(config.channel);
+    if(latencyTracing)  detachInterrupt(gpioNum);
+    ringBuf     = NULL;
+    rxInstalled = false;
+    rxPinInstalled[rmtPort] = false;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRtxBase::stopIR()
+{
+    if(!txInstalled) return;
+    stopBeaconAutopilot();
+    if(DEBUG){
+        Serial.print("ESP32_IR::Uninstalling..");
+        Serial.print("Port : "); Serial.println(rmtPort);
+    }
+    rmt_driver_uninstall((rmt_channel_t)rmtPort);
+    txInstalled = false;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+bool ESP32_IRrxBase::irAvailabl()
+{
+//    bool returnValue = false;
+//
+//    RingbufHandle_t rb = NULL;
+//    rmt_config_t config;
+//    config.channel = (rmt_channel_t)rmtPort;
+//    rmt_get_ringbuf_handle(config.channel, &rb);
+//
+//    while(rb)
+//    {
+//        size_t itemSize = 0;    //Size of ringBuffer data
+//        rmt_item32_t *item = (rmt_item32_t*) xRingbufferReceive(rb, &itemSize, (TickType_t)TIMEOUT_US);
+//        int numItems = itemSize / sizeof(rmt_item32_t);
+//
+//        if( numItems == 0)
+//        {
+//            returnValue = false;
+//        }
+//        else
+//        {
+//            memset(irDataRxArray, 0, sizeof(irDataRxArray));
+//            decodeLTTO(item, numItems, irDataRxArray);
+//            vRingbufferReturnItem(rb, (void*) item);
+//            returnValue = true;
+//        }
+//
+//    }
+//    //vTaskDelete(NULL);
+//    return returnValue;
+    return false;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+int ESP32_IRrxBase::readIR(unsigned int *irDataRx, int maxBuf)
+{
+    ESP32_IRrxItem _rxItem = receiveItem();
+    int numItems = _rxItem.size();
+    if( numItems == 0)  return 0;
+    //Serial.print("ESP32_IR::readIR() - Found num of Items =");Serial.println(numItems*2-1);
+    memset(irDataRx, 0, maxBuf);
+    //decodeRAW(_rxItem.data(), numItems, irDataRx);
+    if(decodeIR(_rxItem.data(), numItems) && !acceptMessage(_rxItem))   return 0;
+    return (numItems*2-1);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+ESP32_IRrxItem ESP32_IRrxBase::receiveItem()
+{
+    return receiveItem((TickType_t)TIMEOUT_US);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+ESP32_IRrxItem ESP32_IRrxBase::receiveItem(TickType_t _ticksToWait)
+{
+    if(medium != NULL)
+    {
+        //Simulated bursts belong to the medium, there is nothing to hand back.
+        rmt_item32_t *_items = NULL;
+        int64_t _lastEdgeTime = 0;
+        int _numItems = medium->receive(mediumNode, &_items, &_lastEdgeTime);
+        if(_numItems > 0)   _numItems = filterGlitches(_items, _numItems);
+        if(_numItems == 0)  return ESP32_IRrxItem();
+        ESP32_IRrxItem _rxItem(NULL, _items, _numItems);
+        if(latencyTracing)  _rxItem.stamp(_lastEdgeTime, medium->now());
+        return _rxItem;
+    }
+    if(edgeCapture != NULL)
+    {
+        rmt_item32_t *_items = NULL;
+        int64_t _lastEdgeTime = 0;
+        int _numItems = edgeCapture->receive(edgeSensor, &_items, &_lastEdgeTime);
+        if(_numItems > 0)   _numItems = filterGlitches(_items, _numItems);
+        if(_numItems == 0)  return ESP32_IRrxItem();
+        ESP32_IRrxItem _rxItem(NULL, _items, _numItems);
+        if(latencyTracing)  _rxItem.stamp(_lastEdgeTime, edgeCapture->now());
+        return _rxItem;
+    }
+    if(ringBuf == NULL) return ESP32_IRrxItem();
+
+    while(true)
+    {
+        size_t itemSize = 0;    //Size of ringBuffer data
+        rmt_item32_t *item = (rmt_item32_t*) xRingbufferReceive(ringBuf, &itemSize, _ticksToWait);
+        if(item == NULL)    return ESP32_IRrxItem();
+
+        //Every burst had its edges queued, so every burst takes its end - noise too, and before
+        //filterGlitches() changes its length.
+        int     _numItems   = itemSize / sizeof(rmt_item32_t);
+        int64_t _now        = 0;
+        int64_t _burstEnd   = 0;
+        if(latencyTracing)
+        {
+            _now        = esp_timer_get_time();
+            _burstEnd   = takeBurstEnd(_now, item, _numItems);
+        }
+
+        ESP32_IRrxItem _rxItem(ringBuf, item, filterGlitches(item, _numItems));
+        if(_rxItem.size() == 0)
+        {
+            _ticksToWait = 0;   //all noise, the handle gives it back to the ring buffer
+            continue;
+        }
+        if(latencyTracing)  _rxItem.stamp(_burstEnd, _now);
+        if(!shedBurst(_rxItem)) return _rxItem;
+
+        //Shed - go straight on to whatever else is already queued.
+        _ticksToWait = 0;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+bool ESP32_IRrxBase::decodeLTTO(const ESP32_IRrxItem &_rxItem)
+{
+    if(!_rxItem)    return false;
+    if(!decodeLTTO(_rxItem.data(), _rxItem.size(), NULL))   return false;
+    return acceptMessage(_rxItem);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+bool ESP32_IRrxBase::decodeIR(const ESP32_IRrxItem &_rxItem)
+{
+    if(!_rxItem)    return false;
+    if(!decodeIR(_rxItem.data(), _rxItem.size()))   return false;
+    return acceptMessage(_rxItem);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+bool ESP32_IRrxBase::isOwnEcho()
+{
+    if(!echoSuppression)    return false;
+    if(!matchEcho(echoKey(lttoMessage.type, lttoMessage.data), rxTime()))   return false;
+
+    echoSuppressedCount++;
+    lttoMessage.type = ' ';
+    lttoMessage.data = 0;
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRrxBase::attachMedium(ESP32_IRmedium *_medium, int _node)
+{
+    medium      = _medium;
+    mediumNode  = _node;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//Last checks on a good decode, before it is handed to the sketch.
+bool ESP32_IRrxBase::acceptMessage(const ESP32_IRrxItem &_rxItem)
+{
+    if(isOwnEcho() || shedRepeat()) return false;
+    traceLatency(_rxItem);
+    assembleMessage();
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//Packet starts a message, Data packets are added, a Checksum that matches completes it.
+void ESP32_IRrxBase::assembleMessage()
+{
+    switch(lttoMessage.type)
+    {
+        case PACKET:
+            hostMessage.packetID    = lttoMessage.data;
+            hostMessage.dataCount   = 0;
+            hostMessageOpen         = true;
+            break;
+
+        case DATA:
+            if(!hostMessageOpen)    break;
+            if(hostMessage.dataCount >= MAX_MESSAGE_DATA)
+            {
+                hostMessageOpen = false;
+                break;
+            }
+            hostMessage.data[hostMessage.dataCount++] = lttoMessage.data;
+            break;
+
+        case CHECKSUM:
+        {
+            if(!hostMessageOpen)    break;
+            hostMessageOpen = false;
+
+            uint8_t _sum = hostMessage.packetID;
+            for(int index = 0; index < hostMessage.dataCount; index++)  _sum += hostMessage.data[index];
+            if(_sum != (uint8_t)lttoMessage.data)   break;
+
+            //FNV-1a
+            uint32_t _hash = 2166136261UL;
+            _hash = (_hash ^ hostMessage.packetID) * 16777619UL;
+            for(int index = 0; index < hostMessage.dataCount; index++)  _hash = (_hash ^ hostMessage.data[index]) * 16777619UL;
+            hostMessage.checksum    = _sum;
+            hostMessage.hash        = _hash;
+
+            messageCount++;
+            hostMessageRepeated = messageCacheLookup(hostMessage, rxTime());
+            if(hostMessageRepeated) messageCacheHits++;
+            else                    hostMessageNew = true;
+            if(DEBUG && hostMessageRepeated)    Serial.println("ESP32_IR::assembleMessage() - repeat");
+            break;
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//True if _message was seen inside the window. Either way it is now the most recent sighting.
+//The hash only picks out candidates - two messages that share one are told apart by their bytes.
+bool ESP32_IRrxBase::messageCacheLookup(const LttoHostMessage &_message, int64_t _now)
+{
+    int     _oldest = 0;
+    int64_t _window = (int64_t)messageCacheWindowMs * 1000;
+
+    if(_now == 0)   _now = 1;   //0 marks an empty entry
+    for(int index = 0; index < MESSAGE_CACHE_SIZE; index++)
+    {
+        MessageCacheEntry &_entry = messageCache[index];
+        if(_entry.lastSeen != 0 && _entry.hash == _message.hash
+           && _entry.packetID == _message.packetID && _entry.dataCount == _message.dataCount
+           && memcmp(_entry.data, _message.data, _message.dataCount) == 0)
+        {
+            bool _hit = (_now - _entry.lastSeen) < _window;
+            _entry.lastSeen = _now;
+            return _hit;
+        }
+        if(_entry.lastSeen < messageCache[_oldest].lastSeen)  _oldest = index;
+    }
+
+    MessageCacheEntry &_entry = messageCache[_oldest];
+    _entry.hash         = _message.hash;
+    _entry.packetID     = _message.packetID;
+    _entry.dataCount    = _message.dataCount;
+    memcpy(_entry.data, _message.data, _message.dataCount);
+    _entry.lastSeen     = _now;
+    return false;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+bool ESP32_IRrxBase::messageAvailable()
+{
+    bool _available = hostMessageNew;
+    hostMessageNew  = false;
+    return _available;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+bool ESP32_IRrxBase::readMessageRepeated()
+{
+    return hostMessageRepeated;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+const LttoHostMessage &ESP32_IRrxBase::readMessage()
+{
+    return hostMessage;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRrxBase::setMessageCacheWindow(uint32_t _ms)
+{
+    messageCacheWindowMs = _ms;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t ESP32_IRrxBase::readMessageCount()
+{
+    return messageCount;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t ESP32_IRrxBase::readMessageCacheHits()
+{
+    return messageCacheHits;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRrxBase::clearMessageCacheCounters()
+{
+    messageCount        = 0;
+    messageCacheHits    = 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//Checks the ring buffer backlog as each burst is taken out. Under load, LTTO/LTAR beacons are
+//dropped from the header alone, without decoding them.
+bool ESP32_IRrxBase::shedBurst(const ESP32_IRrxItem &_rxItem)
+{
+    size_t _backlog = readBacklog();
+    if(_backlog > backlogPeak)  backlogPeak = _backlog;
+
+    //The RMT driver drops (and only logs) a burst that doesn't fit.
+    bool _nearlyFull = (ringBufferSize - _backlog) < RX_MAX_BURST_BYTES;
+    if(_nearlyFull && !nearlyFull)  overflowCount++;
+    nearlyFull = _nearlyFull;
+
+    overloaded = (_backlog * 100) > (ringBufferSize * shedWatermark);
+    if(!overloaded || _rxItem.size() < 2)   return false;
+
+    if(checkData(_rxItem.data(), 0, 0, PRE_SYNC_MARK) && checkData(_rxItem.data(), 1, 0, BEACON_HEADER))
+    {
+        shedBeaconCount++;
+        return true;
+    }
+    return false;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//Under load, a tag or beacon identical to the last one (inside RX_DUPLICATE_US) is dropped.
+//Packet/Data/Checksum are never shed, as a hosting message often carries the same byte twice.
+bool ESP32_IRrxBase::shedRepeat()
+{
+    int64_t _now    = rxTime();
+    char    _type   = lttoMessage.type;
+    bool    _repeat = _type == lastMessageType && lttoMessage.data == lastMessageData
+                      && (_now - lastMessageTime) < RX_DUPLICATE_US
+                      && _type != PACKET && _type != DATA && _type != CHECKSUM;
+
+    lastMessageType = _type;
+    lastMessageData = lttoMessage.data;
+    lastMessageTime = _now;
+
+    if(!_repeat || !overloaded) return false;
+
+    shedDuplicateCount++;
+    lttoMessage.type = ' ';
+    lttoMessage.data = 0;
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRrxBase::setShedWatermark(uint8_t _percent)
+{
+    shedWatermark = (_percent > 100) ? 100 : _percent;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+size_t ESP32_IRrxBase::readBacklog()
+{
+    if(ringBuf == NULL) return 0;
+    return ringBufferSize - xRingbufferGetCurFreeSize(ringBuf);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+size_t ESP32_IRrxBase::readBacklogPeak()
+{
+    return backlogPeak;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t ESP32_IRrxBase::readShedBeaconCount()
+{
+    return shedBeaconCount;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t ESP32_IRrxBase::readShedDuplicateCount()
+{
+    return shedDuplicateCount;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t ESP32_IRrxBase::readOverflowCount()
+{
+    return overflowCount;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRrxBase::clearOverloadCounters()
+{
+    backlogPeak         = 0;
+    shedBeaconCount     = 0;
+    shedDuplicateCount  = 0;
+    overflowCount       = 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//The protocol whose timing the glitch filter uses - the one the burst's sync dispatches to, found
+//past any runts (marks under glitchMarkUs) in front of it. _syncIndex is where the sync is, NULL and 0
+//if the burst doesn't start like any protocol.
+const IRprotocol *ESP32_IRrxBase::glitchProtocol(const rmt_item32_t *_items, int _numItems, int &_syncIndex)
+{
+    for(_syncIndex = 0; _syncIndex < _numItems; _syncIndex++)
+    {
+        const IRprotocol *_protocol = findProtocol(&_items[_syncIndex], 1);
+        if(_protocol != NULL)                           return _protocol;
+        if(_items[_syncIndex].duration0 >= glitchMarkUs)  break;
+    }
+    _syncIndex = 0;
+    return NULL;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//One pass, in place. Each item is either copied down, merged into the mark before it (the space
+//between them was a glitch), or dropped into the space before it (a runt mark). Returns the new count.
+int ESP32_IRrxBase::filterGlitches(rmt_item32_t *_items, int _numItems)
+{
+    if(glitchGapUs == 0 && glitchMarkUs == 0)   return _numItems;
+
+    int                 _syncIndex;
+    const IRprotocol   *_protocol   = glitchProtocol(_items, _numItems, _syncIndex);
+    uint16_t            _gapUs      = glitchGapUs;
+    uint16_t            _markUs     = glitchMarkUs;
+    if(_protocol != NULL && _protocol->shortestSpace > 0)  _gapUs  = _protocol->shortestSpace / RX_GLITCH_FRACTION;
+    if(_protocol != NULL && _protocol->shortestMark > 0)   _markUs = _protocol->shortestMark / RX_GLITCH_FRACTION;
+
+    int _out        = 0;
+    int _repairs    = 0;
+    for(int index = 0; index < _numItems; index++)
+    {
+        rmt_item32_t _item = _items[index];
+
+        if(_out > 0 && _items[_out - 1].duration1 != 0 && _items[_out - 1].duration1 < _gapUs)
+        {
+            rmt_item32_t &_last = _items[_out - 1];
+            uint32_t _mark  = _last.duration0 + _last.duration1 + _item.duration0;
+            _last.duration0 = (_mark > 32767) ? 32767 : _mark;
+            _last.duration1 = _item.duration1;
+            glitchGapsMerged++;
+            _repairs++;
+            continue;
+        }
+
+        if(_item.duration0 < _markUs || index < _syncIndex)
+        {
+            if(_out > 0)
+            {
+                //A runt at the end of the burst leaves the mark before it as the last one.
+                rmt_item32_t &_last = _items[_out - 1];
+                uint32_t _space = _last.duration1 + _item.duration0 + _item.duration1;
+                _last.duration1 = (_item.duration1 == 0) ? 0 : (_space > 32767) ? 32767 : _space;
+            }
+            glitchMarksDropped++;
+            _repairs++;
+            continue;
+        }
+
+        _items[_out++] = _item;
+    }
+
+    if(_repairs > 0)
+    {
+        glitchBurstsRepaired++;
+        if(DEBUG)   { Serial.print("ESP32_IRrx::filterGlitches() - repairs = "); Serial.println(_repairs); }
+    }
+    return _out;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRrxBase::setGlitchFilter(uint16_t _maxGapUs, uint16_t _minMarkUs)
+{
+    glitchGapUs     = _maxGapUs;
+    glitchMarkUs    = _minMarkUs;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t ESP32_IRrxBase::readGlitchGapsMerged()
+{
+    return glitchGapsMerged;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t ESP32_IRrxBase::readGlitchMarksDropped()
+{
+    return glitchMarksDropped;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t ESP32_IRrxBase::readGlitchBurstsRepaired()
+{
+    return glitchBurstsRepaired;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRrxBase::clearGlitchCounters()
+{
+    glitchGapsMerged        = 0;
+    glitchMarksDropped      = 0;
+    glitchBurstsRepaired    = 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+int64_t ESP32_IRrxBase::rxTime()
+{
+    if(medium != NULL)      return medium->now();
+    if(edgeCapture != NULL) return edgeCapture->now();
+    return esp_timer_get_time();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRrxBase::setLatencyTracing(bool _enabled)
+{
+    if(_enabled == latencyTracing)  return;
+    latencyTracing = _enabled;
+
+    //The RMT only tells us about a burst once it has gone idle, so the last edge comes from a pin interrupt.
+    if(!rxInstalled || medium != NULL)  return;
+    if(_enabled)    attachInterruptArg(gpioNum, edgeISR, this, CHANGE);
+    else            detachInterrupt(gpioNum);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//Any edge on the Rx pin. An edge after more than RX_IDLE_US of quiet starts a new burst, so the
+//previous edge was the end of a burst the RMT has passed to the ring buffer.
+void IRAM_ATTR ESP32_IRrxBase::edgeISR(void *_arg)
+{
+    ESP32_IRrxBase *_rx = (ESP32_IRrxBase *)_arg;
+    int64_t _now = esp_timer_get_time();
+
+    portENTER_CRITICAL_ISR(&_rx->edgeMux);
+    if(_rx->lastEdge == 0 || _now - _rx->lastEdge > RX_IDLE_US)
+    {
+        if(_rx->lastEdge != 0)
+        {
+            //Full means nobody is reading - drop the oldest, the ring buffer is overflowing anyway.
+            if(_rx->burstEndCount == LATENCY_EDGE_QUEUE)    _rx->burstEndCount--;
+            _rx->burstStart[_rx->burstEndHead]  = _rx->firstEdge;
+            _rx->burstEnd[_rx->burstEndHead]    = _rx->lastEdge;
+            _rx->burstEndHead = (_rx->burstEndHead + 1) % LATENCY_EDGE_QUEUE;
+            _rx->burstEndCount++;
+        }
+        _rx->firstEdge = _now;
+    }
+    _rx->lastEdge = _now;
+    portEXIT_CRITICAL_ISR(&_rx->edgeMux);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//Matches the item just taken from the ring buffer to the end time of its burst. A burst the RMT never
+//delivered (all noise to its filter, or dropped on a full ring buffer) still had its edges queued, so
+//the oldest queued burst isn't always this one - it is the oldest as long as this one, first edge to
+//last, and any older are discarded. If none match the end isn't known, and the queue is left as it
+//is for the bursts behind this one.
+int64_t ESP32_IRrxBase::takeBurstEnd(int64_t _now, const rmt_item32_t *_items, int _numItems)
+{
+    int64_t _span = 0;
+    for(int index = 0; index < _numItems; index++)  _span += _items[index].duration0 + _items[index].duration1;
+
+    int64_t _end = 0;
+    portENTER_CRITICAL(&edgeMux);
+    for(int _age = burstEndCount; _age > 0; _age--)
+    {
+        int _slot = (burstEndHead + LATENCY_EDGE_QUEUE - _age) % LATENCY_EDGE_QUEUE;
+        if(llabs(burstEnd[_slot] - burstStart[_slot] - _span) > LATENCY_SPAN_US)    continue;
+        _end            = burstEnd[_slot];
+        burstEndCount   = _age - 1;
+        break;
+    }
+    if(_end == 0 && lastEdge != 0 && _now - lastEdge >= RX_IDLE_US
+       && llabs(lastEdge - firstEdge - _span) <= LATENCY_SPAN_US)
+    {
+        //The latest burst - nothing has started since, so it's still in lastEdge.
+        _end            = lastEdge;
+        lastEdge        = 0;
+        burstEndCount   = 0;
+    }
+    portEXIT_CRITICAL(&edgeMux);
+    return _end;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRrxBase::traceLatency(const ESP32_IRrxItem &_rxItem)
+{
+    if(!latencyTracing) return;
+
+    lttoMessage.lastEdgeTime    = _rxItem.readLastEdgeTime();
+    lttoMessage.rxCompleteTime  = lttoMessage.lastEdgeTime ? lttoMessage.lastEdgeTime + RX_IDLE_US : 0;
+    lttoMessage.dequeueTime     = _rxItem.readDequeueTime();
+    lttoMessage.decodeTime      = rxTime();
+    lttoMessage.deliverTime     = 0;
+
+    if(lttoMessage.rxCompleteTime)  recordLatency(LAT_QUEUE, lttoMessage.dequeueTime - lttoMessage.rxCompleteTime);
+    if(lttoMessage.dequeueTime)     recordLatency(LAT_DECODE, lttoMessage.decodeTime - lttoMessage.dequeueTime);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRrxBase::markDelivered()
+{
+    if(!latencyTracing || lttoMessage.decodeTime == 0 || lttoMessage.deliverTime != 0)  return;
+
+    lttoMessage.deliverTime = rxTime();
+    recordLatency(LAT_DELIVER, lttoMessage.deliverTime - lttoMessage.decodeTime);
+    if(lttoMessage.lastEdgeTime)    recordLatency(LAT_TOTAL, lttoMessage.deliverTime - lttoMessage.lastEdgeTime);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRrxBase::recordLatency(int _phase, int64_t _us)
+{
+    if(_us < 0)             _us = 0;        //an edge timestamp from a later burst, or clock steps in the sim
+    if(_us > 0xFFFFFFFF)    _us = 0xFFFFFFFF;
+
+    LatencyStats &_stats = latency[_phase];
+    uint32_t _value = _us;
+    int _bucket = _value ? 32 - __builtin_clz(_value) : 0;
+    if(_bucket >= LATENCY_BUCKETS)  _bucket = LATENCY_BUCKETS - 1;
+
+    if(_stats.count == 0 || _value < _stats.minUs)  _stats.minUs = _value;
+    if(_value > _stats.maxUs)                       _stats.maxUs = _value;
+    _stats.sumUs += _value;
+    _stats.count++;
+    _stats.buckets[_bucket]++;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+LatencySummary ESP32_IRrxBase::readLatency(int _phase)
+{
+    LatencySummary _summary = {0, 0, 0, 0, 0};
+    if(_phase < 0 || _phase >= LAT_PHASES)  return _summary;
+
+    LatencyStats &_stats = latency[_phase];
+    if(_stats.count == 0)   return _summary;
+
+    _summary.count  = _stats.count;
+    _summary.minUs  = _stats.minUs;
+    _summary.maxUs  = _stats.maxUs;
+    _summary.avgUs  = _stats.sumUs / _stats.count;
+
+    uint32_t _target = _stats.count - _stats.count / 100;      //99% of the samples are at or below this one
+    uint32_t _seen   = 0;
+    for(int _bucket = 0; _bucket < LATENCY_BUCKETS; _bucket++)
+    {
+        _seen += _stats.buckets[_bucket];
+        if(_seen >= _target)
+        {
+            _summary.p99Us = (_bucket == 0) ? 0 : (1UL << _bucket) - 1;
+            break;
+        }
+    }
+    if(_summary.p99Us > _summary.maxUs) _summary.p99Us = _summary.maxUs;
+    return _summary;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRrxBase::clearLatency()
+{
+    memset(latency, 0, sizeof(latency));
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//Only valid frames move the averages - a frame that failed is mostly noise, and is just counted.
+void ESP32_IRrxBase::recordQuality(bool _valid)
+{
+    quality.frames++;
+    if(!_valid)
+    {
+        quality.invalidFrames++;
+        return;
     }
 
-    if(DEBUG)
+    //First valid frame starts the averages where it is, rather than climbing from 0.
+    if(quality.frames - quality.invalidFrames == 1)
     {
-        Serial.print("\tESP32_IR::encodeLTTO (String) - ");
-        Serial.print(_type);Serial.print(" ");
-        Serial.println(_data);
+        qualityMeanAverage  = (uint32_t)lttoMessage.meanDeviation << QUALITY_AVERAGE_SHIFT;
+        qualityMaxAverage   = (uint32_t)lttoMessage.maxDeviation  << QUALITY_AVERAGE_SHIFT;
     }
+    qualityMeanAverage += lttoMessage.meanDeviation - (int32_t)(qualityMeanAverage >> QUALITY_AVERAGE_SHIFT);
+    qualityMaxAverage  += lttoMessage.maxDeviation  - (int32_t)(qualityMaxAverage  >> QUALITY_AVERAGE_SHIFT);
+    quality.meanDeviation   = qualityMeanAverage >> QUALITY_AVERAGE_SHIFT;
+    quality.maxDeviation    = qualityMaxAverage  >> QUALITY_AVERAGE_SHIFT;
+}
 
-    //Populate the array
-    //PreSync
-    irDataArray[arrayIndex].duration0 = PRE_SYNC_MARK;
-    irDataArray[arrayIndex].level0    = 1;
-    irDataArray[arrayIndex].duration1 = PRE_SYNC_SPACE;
-    irDataArray[arrayIndex++].level1  = 0;
+//////////////////////////////////////////////////////////////////////////////////////////
 
-    _totalMessageTime += (PRE_SYNC_MARK + PRE_SYNC_SPACE);
+SignalQuality ESP32_IRrxBase::readSignalQuality()
+{
+    return quality;
+}
 
-    //Header
-    irDataArray[arrayIndex].duration0 = _syncHeader;
-    irDataArray[arrayIndex].level0    = 1;
-    irDataArray[arrayIndex].duration1 = MARK_SPACE;
-    irDataArray[arrayIndex++].level1  = 0;
+//////////////////////////////////////////////////////////////////////////////////////////
 
-    _totalMessageTime += (_syncHeader + MARK_SPACE);
+void ESP32_IRrxBase::clearSignalQuality()
+{
+    memset(&quality, 0, sizeof(quality));
+    qualityMeanAverage  = 0;
+    qualityMaxAverage   = 0;
+}
 
-    //Data
-    int _dataPulse = 0;
-    _bitCount--;
+//////////////////////////////////////////////////////////////////////////////////////////
 
-    while (_bitCount >= 0)
-    {
-        _dataPulse = (bitRead(_data, _bitCount)+1) * 1000;            // the +1 is to convert 0/1 data into 1/2mS pulses.
+const LttoMessage &ESP32_IRrxBase::readLttoMessage()
+{
+    return lttoMessage;
+}
 
-        irDataArray[arrayIndex].duration0 = _dataPulse;
-        irDataArray[arrayIndex].level0    = 1;
-        irDataArray[arrayIndex].duration1 = MARK_SPACE;
-        irDataArray[arrayIndex++].level1  = 0;
+//////////////////////////////////////////////////////////////////////////////////////////
 
-        _totalMessageTime += (_dataPulse + MARK_SPACE);
+void ESP32_IRrxBase::attachEdgeCapture(ESP32_IRedgeCapture *_capture, int _sensor)
+{
+    edgeCapture = _capture;
+    edgeSensor  = _sensor;
+}
 
-        _bitCount--;
-    }
+//////////////////////////////////////////////////////////////////////////////////////////
 
-    //Set the end of data marker
-    irDataArray[arrayIndex].duration0 = (_endOfPacketDelay/2);
-    irDataArray[arrayIndex].level0    = 0;
-    irDataArray[arrayIndex].duration1 = (_endOfPacketDelay/2);
-    irDataArray[arrayIndex++].level1  = 0;
+void ESP32_IRrxBase::setEchoSuppression(bool _enabled)
+{
+    echoSuppression = _enabled;
+}
 
-    _totalMessageTime += _endOfPacketDelay;
+//////////////////////////////////////////////////////////////////////////////////////////
 
-    if(_setEndOfPacket)
-    {
-        //Serial.print("\tESP32_IR::encodeLTTO() - Packet Length = ");Serial.print(_totalMessageTime/1000.0);Serial.println("mS");
-        irDataArray[arrayIndex].duration0 = 0;
-        irDataArray[arrayIndex].level0    = 0;
-        irDataArray[arrayIndex].duration1 = 0;
-        irDataArray[arrayIndex].level1    = 0;
-    }
+uint32_t ESP32_IRrxBase::readEchoSuppressedCount()
+{
+    return echoSuppressedCount;
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////
 
-void ESP32_IR::stopIR()
+void ESP32_IRrxBase::clearEchoSuppressedCount()
 {
-    rmt_config_t config;
-    config.channel = (rmt_channel_t)rmtPort;
-    rmt_rx_stop(config.channel);
-    if(DEBUG){
-        Serial.print("ESP32_IR::Uninstalling..");
-    }
-    if(DEBUG){
-        Serial.print("Port : "); Serial.println(config.channel);
-    }
-    rmt_driver_uninstall(config.channel);
+    echoSuppressedCount = 0;
 }
 
+//////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////////////
 
-bool ESP32_IR::irAvailabl()
+ESP32_IRrxItem::ESP32_IRrxItem()
 {
-//    bool returnValue = false;
-//
-//    RingbufHandle_t rb = NULL;
-//    rmt_config_t config;
-//    config.channel = (rmt_channel_t)rmtPort;
-//    rmt_get_ringbuf_handle(config.channel, &rb);
-//
-//    while(rb)
-//    {
-//        size_t itemSize = 0;    //Size of ringBuffer data
-//        rmt_item32_t *item = (rmt_item32_t*) xRingbufferReceive(rb, &itemSize, (TickType_t)TIMEOUT_US);
-//        int numItems = itemSize / sizeof(rmt_item32_t);
-//
-//        if( numItems == 0)
-//        {
-//            returnValue = false;
-//        }
-//        else
-//        {
-//            memset(irDataRxArray, 0, sizeof(irDataRxArray));
-//            decodeLTTO(item, numItems, irDataRxArray);
-//            vRingbufferReturnItem(ringBuf, (void*) item);
-//            returnValue = true;
-//        }
-//
-//    }
-//    //vTaskDelete(NULL);
-//    return returnValue;
-    return false;
+    ringBuf     = NULL;
+    items       = NULL;
+    numItems    = 0;
+    lastEdgeTime    = 0;
+    dequeueTime     = 0;
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////
 
-int ESP32_IR::readIR(unsigned int *irDataRx, int maxBuf)
+ESP32_IRrxItem::ESP32_IRrxItem(RingbufHandle_t _ringBuf, rmt_item32_t *_items, int _numItems)
 {
-    RingbufHandle_t rb = NULL;
-    rmt_config_t config;
-    config.channel = (rmt_channel_t)rmtPort;
-    rmt_get_ringbuf_handle(config.channel, &rb);
+    ringBuf     = _ringBuf;
+    items       = _items;
+    numItems    = _numItems;
+    lastEdgeTime    = 0;
+    dequeueTime     = 0;
+}
 
-    while(rb)
+//////////////////////////////////////////////////////////////////////////////////////////
+
+ESP32_IRrxItem::ESP32_IRrxItem(ESP32_IRrxItem &&_other)
+{
+    ringBuf     = _other.ringBuf;
+    items       = _other.items;
+    numItems    = _other.numItems;
+    lastEdgeTime    = _other.lastEdgeTime;
+    dequeueTime     = _other.dequeueTime;
+    _other.items    = NULL;
+    _other.numItems = 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+ESP32_IRrxItem &ESP32_IRrxItem::operator=(ESP32_IRrxItem &&_other)
+{
+    if(this != &_other)
     {
-        size_t itemSize = 0;    //Size of ringBuffer data
-        rmt_item32_t *item = (rmt_item32_t*) xRingbufferReceive(rb, &itemSize, (TickType_t)TIMEOUT_US);
-        int numItems = itemSize / sizeof(rmt_item32_t);
-        if( numItems == 0)  return 0;
-        //Serial.print("ESP32_IR::readIR() - Found num of Items =");Serial.println(numItems*2-1);
-        memset(irDataRx, 0, maxBuf);
-        //decodeRAW(item, numItems, irDataRx);
-        decodeLTTO(item, numItems, irDataRx);
-        vRingbufferReturnItem(ringBuf, (void*) item);
-        return (numItems*2-1);
+        release();
+        ringBuf     = _other.ringBuf;
+        items       = _other.items;
+        numItems    = _other.numItems;
+        lastEdgeTime    = _other.lastEdgeTime;
+        dequeueTime     = _other.dequeueTime;
+        _other.items    = NULL;
+        _other.numItems = 0;
     }
-    //TODO : work out why this is here and do we really need it !!!!
-    Serial.println("ESP32_IR::readIR() - Do we ever get here?");
-    vTaskDelete(NULL);
-  return 0;
+    return *this;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+ESP32_IRrxItem::~ESP32_IRrxItem()
+{
+    release();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRrxItem::release()
+{
+    if(items != NULL && ringBuf != NULL)    vRingbufferReturnItem(ringBuf, (void*) items);
+    items       = NULL;
+    numItems    = 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRrxItem::stamp(int64_t _lastEdgeTime, int64_t _dequeueTime)
+{
+    lastEdgeTime    = _lastEdgeTime;
+    dequeueTime     = _dequeueTime;
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////
 
-void ESP32_IR::decodeRAW(rmt_item32_t *rawDataIn, int numItems, unsigned int *irDataOut)
+void ESP32_IRrxBase::decodeRAW(rmt_item32_t *rawDataIn, int numItems, unsigned int *irDataOut)
 {
     if(DEBUG)   Serial.print("ESP32_IR::Raw IR Code :");
     int _bitCount = 0;
@@ -500,7 +2110,7 @@ void ESP32_IR::decodeRAW(rmt_item32_t *rawDataIn, int numItems, unsigned int *ir
 
 //////////////////////////////////////////////////////////////////////////////////////////
 
-void ESP32_IR::getDataIR(rmt_item32_t item, unsigned int* irDataOut, int index) {
+void ESP32_IRrxBase::getDataIR(rmt_item32_t item, unsigned int* irDataOut, int index) {
     unsigned int lowValue = (item.duration0) * (10 / TICK_10_US)-SPACE_EXCESS;
     lowValue = ROUND_TO * round((float)lowValue/ROUND_TO);
     //Serial.print(lowValue);Serial.print("L ,");
@@ -513,7 +2123,38 @@ void ESP32_IR::getDataIR(rmt_item32_t item, unsigned int* irDataOut, int index)
 
 //////////////////////////////////////////////////////////////////////////////////////////
 
-bool ESP32_IR::decodeLTTO(rmt_item32_t *rawDataIn, int numItems, unsigned int *irDataOut)
+bool ESP32_IRrxBase::decodeLTTO(const rmt_item32_t *rawDataIn, int numItems, unsigned int *irDataOut)
+{
+    bool _validDataPacket = parseLTTO(rawDataIn, numItems, lttoMessage);
+    checkCollision(_validDataPacket, rawDataIn, numItems);
+    recordQuality(_validDataPacket);
+    return _validDataPacket;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//Signal quality helpers for parseLTTO() - how far a pulse is from nominal, in per mille (capped at 1000).
+static inline unsigned int nearestDuration(unsigned int _duration, unsigned int _first, unsigned int _second)
+{
+    unsigned int _toFirst   = (_duration > _first)  ? _duration - _first  : _first  - _duration;
+    unsigned int _toSecond  = (_duration > _second) ? _duration - _second : _second - _duration;
+    return (_toFirst <= _toSecond) ? _first : _second;
+}
+
+static inline void addDeviation(unsigned int _duration, unsigned int _expected, uint32_t &_sum, uint16_t &_max, int &_count)
+{
+    unsigned int _error     = (_duration > _expected) ? _duration - _expected : _expected - _duration;
+    unsigned int _perMille  = _error * 1000 / _expected;
+    if(_perMille > 1000)    _perMille = 1000;
+
+    _sum += _perMille;
+    if(_perMille > _max)    _max = _perMille;
+    _count++;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+bool ESP32_IRrxBase::parseLTTO(const rmt_item32_t *rawDataIn, int numItems, LttoMessage &lttoMessage)
 {
     //Serial.println("-----------------------");
     bool _validPreSync      = false;
@@ -527,6 +2168,16 @@ bool ESP32_IR::decodeLTTO(rmt_item32_t *rawDataIn, int numItems, unsigned int *i
     //Clear the message data
     lttoMessage.type = ' ';
     lttoMessage.data = 0;
+    lttoMessage.meanDeviation   = 0;
+    lttoMessage.maxDeviation    = 0;
+
+    //Needs at least the pre-sync and the header
+    if (numItems < 2)   return false;
+
+    //Timing deviation of every pulse checked, against the nearest nominal duration
+    uint32_t _deviationSum      = 0;
+    uint16_t _deviationMax      = 0;
+    int      _deviationCount    = 0;
 
     /*  Pseudo Code
      -Create a structure char+unsigned int
@@ -543,6 +2194,13 @@ bool ESP32_IR::decodeLTTO(rmt_item32_t *rawDataIn, int numItems, unsigned int *i
         _validPreSync = true;
         //Serial.println("ESP32_IR:: PreSyncOK!");
 
+    addDeviation(rawDataIn[0].duration0, PRE_SYNC_MARK,  _deviationSum, _deviationMax, _deviationCount);
+    addDeviation(rawDataIn[0].duration1, PRE_SYNC_SPACE, _deviationSum, _deviationMax, _deviationCount);
+    addDeviation(rawDataIn[1].duration0, nearestDuration(rawDataIn[1].duration0, TAG_PACKET_HEADER, BEACON_HEADER),
+                 _deviationSum, _deviationMax, _deviationCount);
+    //As with the bits, a header with nothing after it has no space - the burst ended there.
+    if (numItems > 2)   addDeviation(rawDataIn[1].duration1, MARK_SPACE, _deviationSum, _deviationMax, _deviationCount);
+
     int _bitCount = numItems-2;
 
     //Calculate the valus of the bits.
@@ -568,12 +2226,19 @@ bool ESP32_IR::decodeLTTO(rmt_item32_t *rawDataIn, int numItems, unsigned int *i
         }
         //Serial.print("ESP32_IR:: Counting Data = "); Serial.println(_totalOfBits);
 
-        if (!checkData(rawDataIn, index, 1, MARK_SPACE))
+        addDeviation(rawDataIn[index].duration0, nearestDuration(rawDataIn[index].duration0, ZERO_BIT, ONE_BIT),
+                     _deviationSum, _deviationMax, _deviationCount);
+
+        //The last bit has no space, the RMT ends the burst on the idle threshold instead.
+        if (index < numItems - 1 && !checkData(rawDataIn, index, 1, MARK_SPACE))
         {
             _badMarkSpace = true;
         }
+        if (index < numItems - 1)   addDeviation(rawDataIn[index].duration1, MARK_SPACE, _deviationSum, _deviationMax, _deviationCount);
     }
     lttoMessage.data = _totalOfBits;
+    lttoMessage.meanDeviation   = _deviationSum / _deviationCount;
+    lttoMessage.maxDeviation    = _deviationMax;
     //Serial.print("ESP32_IR:: Data = "); Serial.println(lttoMessage.data);
 
 
@@ -614,11 +2279,11 @@ bool ESP32_IR::decodeLTTO(rmt_item32_t *rawDataIn, int numItems, unsigned int *i
         {
             case BEACON_BIT_COUNT:
                 lttoMessage.type = BEACON;
-                Serial.println("ESP32:: LTTO Beacon");
+                if(DEBUG)   Serial.println("ESP32:: LTTO Beacon");
                 break;
             case LTAR_BEACON_BIT_COUNT:
                 lttoMessage.type = LTAR_BEACON;
-                Serial.println("ESP32:: LTAR Beacon");
+                if(DEBUG)   Serial.println("ESP32:: LTAR Beacon");
                 break;
             default:
                 lttoMessage.type = 'V';   //Void
@@ -639,7 +2304,7 @@ bool ESP32_IR::decodeLTTO(rmt_item32_t *rawDataIn, int numItems, unsigned int *i
 
 //////////////////////////////////////////////////////////////////////////////////////////
 
-bool ESP32_IR::checkData(rmt_item32_t *rawDataIn, int _index, int _itemToCheck, unsigned int _expectedDuration)
+bool ESP32_IRrxBase::checkData(const rmt_item32_t *rawDataIn, int _index, int _itemToCheck, unsigned int _expectedDuration)
 {
     bool _result = false;
 
@@ -668,12 +2333,186 @@ bool ESP32_IR::checkData(rmt_item32_t *rawDataIn, int _index, int _itemToCheck,
 
 //////////////////////////////////////////////////////////////////////////////////////////
 
-char    ESP32_IR::readMessageType()
+void ESP32_IRrxBase::checkCollision(bool _validDataPacket, const rmt_item32_t *rawDataIn, int numItems)
+{
+    bool _validPreSync = checkData(rawDataIn, 0, 0, PRE_SYNC_MARK) && checkData(rawDataIn, 0, 1, PRE_SYNC_SPACE);
+
+    lastRxCollision = !_validDataPacket && isCollision(rawDataIn, numItems, _validPreSync);
+    if(lastRxCollision)
+    {
+        collisionCount++;
+        if(medium != NULL)  medium->recordCollision(mediumNode, rxTime());
+        else                lastCollisionTime = rxTime();
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//A burst that can't be a single LTTO packet, in a way that noise doesn't explain, is two taggers
+//talking at once - overlapping marks run together into one too long for any symbol, a space
+//inside the packet is shorter than any the protocol uses, or two packets arrive with no idle gap.
+//Only a burst that starts as LTTO does (a pre-sync mark, or a header after it) is judged - anything
+//else, like a NEC remote's 9mS leader, would look like a collision, and is left unclassified.
+bool ESP32_IRrxBase::isCollision(const rmt_item32_t *rawDataIn, int numItems, bool _validPreSync)
+{
+    const unsigned int  _longestMark    = BEACON_HEADER * (1 + VARIATION);
+    const unsigned int  _shortestSpace  = MARK_SPACE    * (1 - VARIATION);
+
+    bool _startsAsLtto = numItems > 0 && checkData(rawDataIn, 0, 0, PRE_SYNC_MARK);
+    if(numItems > 1 && (checkData(rawDataIn, 1, 0, TAG_PACKET_HEADER) || checkData(rawDataIn, 1, 0, BEACON_HEADER)))
+        _startsAsLtto = true;
+    if(!_startsAsLtto)                          return false;
+
+    if(numItems - 2 > CHECKSUM_BIT_COUNT)       return true;
+
+    for(int index = 0; index < numItems; index++)
+    {
+        if(rawDataIn[index].duration0 > _longestMark)       return true;
+        if(_validPreSync && index < numItems - 1
+           && rawDataIn[index].duration1 < _shortestSpace)  return true;
+    }
+    return false;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+bool ESP32_IRrxBase::readCollision()
+{
+    return lastRxCollision;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t ESP32_IRrxBase::readCollisionCount()
+{
+    return collisionCount;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+bool ESP32_IRrxBase::collisionSince(int64_t _time)
+{
+    return lastCollisionTime > _time;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//Carrier sense for listen-before-talk. IR receiver modules pull their output low while they
+//see a carrier, and the pin can still be read while the RMT owns it. Edge-capture sensors
+//keep the level of their last edge.
+bool ESP32_IRrxBase::carrierSensed()
+{
+    for(int index = 0; index < RMT_CHANNEL_MAX; index++)
+    {
+        if(rxPinInstalled[index] && gpio_get_level((gpio_num_t)rxPins[index]) == 0)  return true;
+    }
+    return ESP32_IRedgeCapture::anyCarrierSensed();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////
+
+bool ESP32_IRrxBase::registerProtocol(const IRprotocol *_protocol)
+{
+    if(protocolCount >= MAX_IR_PROTOCOLS)   return false;
+    protocols[protocolCount++] = _protocol;
+
+    //Claim every cell the sync pair can land in. First come first served, so the built in ones win.
+    int _markFirst  = dispatchBucket(_protocol->syncMark  * (1 - VARIATION));
+    int _markLast   = dispatchBucket(_protocol->syncMark  * (1 + VARIATION));
+    int _spaceFirst = dispatchBucket(_protocol->syncSpace * (1 - VARIATION));
+    int _spaceLast  = dispatchBucket(_protocol->syncSpace * (1 + VARIATION));
+
+    for(int _mark = _markFirst; _mark <= _markLast && _mark < DISPATCH_BUCKETS; _mark++)
+    {
+        for(int _space = _spaceFirst; _space <= _spaceLast && _space < DISPATCH_BUCKETS; _space++)
+        {
+            if(protocolDispatch[_mark][_space] == 0)    protocolDispatch[_mark][_space] = protocolCount;
+        }
+    }
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+const IRprotocol *ESP32_IRrxBase::findProtocol(const rmt_item32_t *rawDataIn, int numItems)
+{
+    if(numItems < 1)    return NULL;
+
+    int _mark   = dispatchBucket(rawDataIn[0].duration0);
+    int _space  = dispatchBucket(rawDataIn[0].duration1);
+    if(_mark >= DISPATCH_BUCKETS || _space >= DISPATCH_BUCKETS) return NULL;
+
+    uint8_t _index = protocolDispatch[_mark][_space];
+    if(_index == 0) return NULL;
+    return protocols[_index - 1];
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+bool ESP32_IRrxBase::decodeIR(const rmt_item32_t *rawDataIn, int numItems)
+{
+    const IRprotocol *_protocol = findProtocol(rawDataIn, numItems);
+
+    //Nothing we know, or LTTO/LTAR - the LTTO decoder also spots collisions.
+    if(_protocol == NULL || _protocol == &lttoProtocol) return decodeLTTO(rawDataIn, numItems, NULL);
+
+    lastRxCollision = false;
+    bool _validFrame = _protocol->parser(rawDataIn, numItems, lttoMessage);
+    recordQuality(_validFrame);
+    return _validFrame;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//BRX: 2mS start, then a 1mS (one) or 0.5mS (zero) mark per bit, each followed by a 0.5mS space.
+bool ESP32_IRrxBase::parseBRX(const rmt_item32_t *rawDataIn, int numItems, LttoMessage &lttoMessage)
+{
+    bool _badData = false;
+
+    lttoMessage.type = ' ';
+    lttoMessage.data = 0;
+    lttoMessage.meanDeviation   = 0;
+    lttoMessage.maxDeviation    = 0;
+
+    if(numItems < 2 || numItems - 1 > 32)   return false;
+    if(!checkData(rawDataIn, 0, 0, BRX_START) || !checkData(rawDataIn, 0, 1, BRX_SPACE))    return false;
+
+    uint32_t _deviationSum      = 0;
+    uint16_t _deviationMax      = 0;
+    int      _deviationCount    = 0;
+    addDeviation(rawDataIn[0].duration0, BRX_START, _deviationSum, _deviationMax, _deviationCount);
+    addDeviation(rawDataIn[0].duration1, BRX_SPACE, _deviationSum, _deviationMax, _deviationCount);
+
+    unsigned int _totalOfBits = 0;
+    for(int index = 1; index < numItems; index++)
+    {
+        if      (checkData(rawDataIn, index, 0, BRX_ONE))   _totalOfBits = (_totalOfBits << 1) | 1;
+        else if (checkData(rawDataIn, index, 0, BRX_ZERO))  _totalOfBits = _totalOfBits << 1;
+        else                                                _badData = true;
+        addDeviation(rawDataIn[index].duration0, nearestDuration(rawDataIn[index].duration0, BRX_ZERO, BRX_ONE),
+                     _deviationSum, _deviationMax, _deviationCount);
+
+        if(index < numItems - 1 && !checkData(rawDataIn, index, 1, BRX_SPACE))  _badData = true;
+        if(index < numItems - 1)    addDeviation(rawDataIn[index].duration1, BRX_SPACE, _deviationSum, _deviationMax, _deviationCount);
+    }
+
+    lttoMessage.type = BRX;
+    lttoMessage.data = _totalOfBits;
+    lttoMessage.meanDeviation   = _deviationSum / _deviationCount;
+    lttoMessage.maxDeviation    = _deviationMax;
+    return !_badData;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+char    ESP32_IRrxBase::readMessageType()
 {
     return lttoMessage.type;
 }
 
-uint16_t ESP32_IR::readRawDataPacket()
+uint16_t ESP32_IRrxBase::readRawDataPacket()
 {
     return lttoMessage.data;
 }
@@ -697,12 +2536,11 @@ uint16_t ESP32_IR::readRawDataPacket()
 
 //////////////////////////////////////////////////////////////////////////////////////////
 
-int ESP32_IR::hostPlayerToGame(uint8_t _teamNumber, uint8_t _playerNumber,  uint8_t _gameType,
+int ESP32_IRtxBase::hostPlayerToGame(uint8_t _teamNumber, uint8_t _playerNumber,  uint8_t _gameType,
                                uint8_t _gameID,     uint8_t _gameLength,    uint8_t _health,
                                uint8_t _reloads,    uint8_t _shields,       uint8_t _megaTags,
                                uint8_t _flags1,     uint8_t _flags2,        int8_t _flags3)
 {
-    uint16_t        _taggerID               = -1;    // -1 means failed !
     uint8_t         _codeLength             = 0;
     bool            _isLtar                 = true;
 
@@ -712,31 +2550,41 @@ int ESP32_IR::hostPlayerToGame(uint8_t _teamNumber, uint8_t _playerNumber,  uint
 
     if(DEBUG)   Serial.println("ESP32_IR - announcing game : ");
 
-    //convert specific data packets to BCD
-    if(_isLtar == false)
-    {
-        _gameLength = convertDecToBCD(_gameLength);
-        _health     = convertDecToBCD(_health);
-        _reloads    = convertDecToBCD(_reloads);
-        _shields    = convertDecToBCD(_shields);
-        _megaTags   = convertDecToBCD(_megaTags);
-    }
+    //The same announce goes out every interval for the whole lobby, so it is only encoded once.
+    const uint8_t _params[] = { _gameType, _gameID,   _gameLength, _health, _reloads, _shields,
+                                _megaTags, _flags1,   _flags2,     (uint8_t)_flags3, _isLtar };
+    if(listenBeforeTalk && !lbtReplaying)   return holdForClearChannel(FRAME_ANNOUNCE, _params, sizeof(_params));
 
-    clearIRdataArray();
+    if(!loadCachedFrame(FRAME_ANNOUNCE, _params, sizeof(_params)))
+    {
+        //convert specific data packets to BCD
+        if(_isLtar == false)
+        {
+            _gameLength = convertDecToBCD(_gameLength);
+            _health     = convertDecToBCD(_health);
+            _reloads    = convertDecToBCD(_reloads);
+            _shields    = convertDecToBCD(_shields);
+            _megaTags   = convertDecToBCD(_megaTags);
+        }
 
-    encodeLTTO(PACKET,  _gameType);
-    encodeLTTO(DATA,    _gameID);
-    encodeLTTO(DATA,    _gameLength);
-    encodeLTTO(DATA,    _health);
-    encodeLTTO(DATA,    _reloads);
-    encodeLTTO(DATA,    _shields);
-    encodeLTTO(DATA,    _megaTags);
-    encodeLTTO(DATA,    _flags1);
-    encodeLTTO(DATA,    _flags2);
-    if(_isLtar) encodeLTTO(DATA, _flags3);
-    encodeLTTO(CHECKSUM);
+        clearIRdataArray();
+
+        encodeLTTO(PACKET,  _gameType);
+        encodeLTTO(DATA,    _gameID);
+        encodeLTTO(DATA,    _gameLength);
+        encodeLTTO(DATA,    _health);
+        encodeLTTO(DATA,    _reloads);
+        encodeLTTO(DATA,    _shields);
+        encodeLTTO(DATA,    _megaTags);
+        encodeLTTO(DATA,    _flags1);
+        encodeLTTO(DATA,    _flags2);
+        if(_isLtar) encodeLTTO(DATA, _flags3);
+        encodeLTTO(CHECKSUM);
+
+        storeCachedFrame();
+    }
 
-    sendIR(irDataArray, sizeof(irDataArray) );
+    sendFrame(irDataArray, txSymbolCount() );
 
     //pseudo code
     //  if(cancelHosting) interval = infinite
@@ -744,12 +2592,12 @@ int ESP32_IR::hostPlayerToGame(uint8_t _teamNumber, uint8_t _playerNumber,  uint
     //  if(irReply.startsWith "P16" respond
     //    else if(irReply.startsWith "P17" respond
 
-    return _taggerID;
+    return LBT_SENT;
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////
 
-void ESP32_IR::assignPlayer(uint8_t _gameID, uint8_t _taggerID, uint8_t _teamNumber, uint8_t _playerNumber, bool _isLtar)
+void ESP32_IRtxBase::assignPlayer(uint8_t _gameID, uint8_t _taggerID, uint8_t _teamNumber, uint8_t _playerNumber, bool _isLtar)
 {
     if(DEBUG)
     {
@@ -759,42 +2607,73 @@ void ESP32_IR::assignPlayer(uint8_t _gameID, uint8_t _taggerID, uint8_t _teamNum
         Serial.println(_playerNumber);
     }
 
-    uint8_t _teamAndPlayer = encodeTeamAndPlayer(_teamNumber, _playerNumber);
+    //A tagger that missed its assignment asks again, and gets the same frame.
+    const uint8_t _params[] = { _gameID, _taggerID, _teamNumber, _playerNumber, _isLtar };
+    if(!loadCachedFrame(FRAME_ASSIGN, _params, sizeof(_params)))
+    {
+        uint8_t _teamAndPlayer = encodeTeamAndPlayer(_teamNumber, _playerNumber);
 
-    clearIRdataArray();
+        clearIRdataArray();
 
-    if(_isLtar) encodeLTTO(PACKET,  131);
-    else        encodeLTTO(PACKET,    1);
-    encodeLTTO(DATA,    _gameID);
-    encodeLTTO(DATA,    _taggerID);
-    encodeLTTO(DATA,    _teamAndPlayer);
-    encodeLTTO(CHECKSUM);
+        if(_isLtar) encodeLTTO(PACKET,  131);
+        else        encodeLTTO(PACKET,    1);
+        encodeLTTO(DATA,    _gameID);
+        encodeLTTO(DATA,    _taggerID);
+        encodeLTTO(DATA,    _teamAndPlayer);
+        encodeLTTO(CHECKSUM);
+
+        storeCachedFrame();
+    }
+
+    sendFrame(irDataArray, txSymbolCount() );
 
-    sendIR(irDataArray, sizeof(irDataArray) );
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//Puts the tagger on the roster (balancing the teams) and sends the assignment, or the failure
+//if the game is full. Returns the roster slot, or -1.
+int ESP32_IRtxBase::assignPlayer(uint8_t _gameID, ESP32_IRroster &_roster, uint8_t _taggerID, uint8_t _preferredTeam, bool _isLtar)
+{
+    int _slot = _roster.addTagger(_taggerID, _preferredTeam);
+    if(_slot < 0)
+    {
+        assignPlayerFailed(_gameID, _taggerID, _isLtar);
+        return -1;
+    }
 
+    const RosterSlot &_entry = _roster.readSlot(_slot);
+    assignPlayer(_gameID, _taggerID, _entry.teamNumber, _entry.playerNumber, _isLtar);
+    return _slot;
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////
 
-void ESP32_IR::assignPlayerFailed(uint8_t _gameID, uint8_t _taggerID, bool _isLtar)
+void ESP32_IRtxBase::assignPlayerFailed(uint8_t _gameID, uint8_t _taggerID, bool _isLtar)
 {
     if(DEBUG)   Serial.print("ESP32_IR::assignPlayerFailed() - TaggerID: ");
     if(DEBUG)   Serial.println(_taggerID);
 
-    clearIRdataArray();
+    const uint8_t _params[] = { _gameID, _taggerID, _isLtar };
+    if(!loadCachedFrame(FRAME_ASSIGN_FAILED, _params, sizeof(_params)))
+    {
+        clearIRdataArray();
 
-    if(_isLtar) encodeLTTO(PACKET,  143);
-    else        encodeLTTO(PACKET,   15);
-    encodeLTTO(DATA,    _gameID);
-    encodeLTTO(DATA,    _taggerID);
-    encodeLTTO(CHECKSUM);
+        if(_isLtar) encodeLTTO(PACKET,  143);
+        else        encodeLTTO(PACKET,   15);
+        encodeLTTO(DATA,    _gameID);
+        encodeLTTO(DATA,    _taggerID);
+        encodeLTTO(CHECKSUM);
 
-    sendIR(irDataArray, sizeof(irDataArray) );
+        storeCachedFrame();
+    }
+
+    sendFrame(irDataArray, txSymbolCount() );
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////
 
-void ESP32_IR::ltarAssignPlayerSuccess(uint8_t _gameID, uint8_t _teamNumber, uint8_t _playerNumber)
+void ESP32_IRtxBase::ltarAssignPlayerSuccess(uint8_t _gameID, uint8_t _teamNumber, uint8_t _playerNumber)
 {
     if(DEBUG)   Serial.println("ESP32_IR::ltarAssignPlayerSuccess()");
 
@@ -807,12 +2686,12 @@ void ESP32_IR::ltarAssignPlayerSuccess(uint8_t _gameID, uint8_t _teamNumber, uin
     encodeLTTO(DATA,    _teamAndPlayer);
     encodeLTTO(CHECKSUM);
 
-    sendIR(irDataArray, sizeof(irDataArray) );
+    sendFrame(irDataArray, txSymbolCount() );
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////
 
-void ESP32_IR::requestTagReport(uint8_t _gameID, uint8_t _teamNumber, uint8_t _playerNumber, uint8_t _reportRequired)
+void ESP32_IRtxBase::requestTagReport(uint8_t _gameID, uint8_t _teamNumber, uint8_t _playerNumber, uint8_t _reportRequired)
 {
     if(DEBUG)   Serial.println("ESP32_IR::requestTagReport()");
 
@@ -825,7 +2704,7 @@ void ESP32_IR::requestTagReport(uint8_t _gameID, uint8_t _teamNumber, uint8_t _p
     encodeLTTO(DATA,    _reportRequired);
     encodeLTTO(CHECKSUM);
 
-    sendIR(irDataArray, sizeof(irDataArray) );
+    sendFrame(irDataArray, txSymbolCount() );
 }
 
 ////////////////////////////
@@ -835,12 +2714,15 @@ void ESP32_IR::requestTagReport(uint8_t _gameID, uint8_t _teamNumber, uint8_t _p
 //////////////////////////////////////////////////////////////////////////////////////////
 //////////////////////////////////////////////////////////////////////////////////////////
 
-void ESP32_IR::taggerRequestToJoin(uint8_t _gameID, uint8_t _taggerID, uint8_t _preferredTeam, bool _isLtar)
+int ESP32_IRtxBase::taggerRequestToJoin(uint8_t _gameID, uint8_t _taggerID, uint8_t _preferredTeam, bool _isLtar)
 //NB in LTAR mode _preferredTeam is actually TaggerInformation (optional)
 {
     if(DEBUG)   Serial.println("ESP32_IR::taggerRequestToJoin()");
     if(_isLtar) _preferredTeam = 0x1B;  //Fake up Firmware Version.
 
+    const uint8_t _params[] = { _gameID, _taggerID, _preferredTeam, _isLtar };
+    if(listenBeforeTalk && !lbtReplaying)   return holdForClearChannel(FRAME_JOIN, _params, sizeof(_params));
+
     clearIRdataArray();
 
     if(_isLtar) encodeLTTO(PACKET, 130);
@@ -850,12 +2732,13 @@ void ESP32_IR::taggerRequestToJoin(uint8_t _gameID, uint8_t _taggerID, uint8_t _
     encodeLTTO(DATA,    _preferredTeam);
     encodeLTTO(CHECKSUM);
 
-    sendIR(irDataArray, sizeof(irDataArray) );
+    sendFrame(irDataArray, txSymbolCount() );
+    return LBT_SENT;
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////
 
-void ESP32_IR::taggerAckPlayerAssign(uint8_t _gameID, uint8_t _taggerID)
+void ESP32_IRtxBase::taggerAckPlayerAssign(uint8_t _gameID, uint8_t _taggerID)
 {
     if(DEBUG)   Serial.println("ESP32_IR::taggerAckPlayerAssign()");
 
@@ -866,12 +2749,12 @@ void ESP32_IR::taggerAckPlayerAssign(uint8_t _gameID, uint8_t _taggerID)
     encodeLTTO(DATA,    _taggerID);
     encodeLTTO(CHECKSUM);
 
-    sendIR(irDataArray, sizeof(irDataArray) );
+    sendFrame(irDataArray, txSymbolCount() );
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////
 
-void ESP32_IR::taggerTagSummary(uint8_t _gameID,          uint8_t _teamAndPlayerNumber,
+void ESP32_IRtxBase::taggerTagSummary(uint8_t _gameID,          uint8_t _teamAndPlayerNumber,
                                 uint8_t _totalNumberTagsRx,
                                 uint8_t _survivalMinutes, uint8_t _survivalSeconds,
                                 uint8_t _zoneTimeMinutes, uint8_t _zoneTimeSeconds,
@@ -892,17 +2775,17 @@ void ESP32_IR::taggerTagSummary(uint8_t _gameID,          uint8_t _teamAndPlayer
     encodeLTTO(DATA,    _teamReportFlag);
     encodeLTTO(CHECKSUM);
 
-    sendIR(irDataArray, sizeof(irDataArray) );
+    sendFrame(irDataArray, txSymbolCount() );
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////
 
-void ESP32_IR::taggerTeamReport(uint8_t _teamToReport,     uint8_t _gameID,                uint8_t _teamAndPlayerNumber,
+void ESP32_IRtxBase::taggerTeamReport(uint8_t _teamToReport,     uint8_t _gameID,                uint8_t _teamAndPlayerNumber,
                                 uint8_t _playersIncluded,  uint8_t _player1tags,           uint8_t _player2tags,
                                 uint8_t _player3tags,      uint8_t _player4tags,           uint8_t _player5tags,
                                 uint8_t _player6tags,      uint8_t _player7tags,           uint8_t _player8tags)
 {
-    if(DEBUG)   Serial.println("ESP32_IR::taggerTagSummary()");
+    if(DEBUG)   Serial.println("ESP32_IR::taggerTeamReport()");
 
     clearIRdataArray();
 
@@ -921,17 +2804,17 @@ void ESP32_IR::taggerTeamReport(uint8_t _teamToReport,     uint8_t _gameID,
     encodeLTTO(DATA,    _gameID);
     encodeLTTO(DATA,    _teamAndPlayerNumber);
     encodeLTTO(DATA,    (_playersIncluded));
-    if(_playersIncluded && 0xb00000001) encodeLTTO(DATA,    (_player1tags));
-    if(_playersIncluded && 0xb00000010) encodeLTTO(DATA,    (_player2tags));
-    if(_playersIncluded && 0xb00000100) encodeLTTO(DATA,    (_player3tags));
-    if(_playersIncluded && 0xb00001000) encodeLTTO(DATA,    (_player4tags));
-    if(_playersIncluded && 0xb00010000) encodeLTTO(DATA,    (_player5tags));
-    if(_playersIncluded && 0xb00100000) encodeLTTO(DATA,    (_player6tags));
-    if(_playersIncluded && 0xb01000000) encodeLTTO(DATA,    (_player7tags));
-    if(_playersIncluded && 0xb10000000) encodeLTTO(DATA,    (_player8tags));
+    if(_playersIncluded & 0b00000001)  encodeLTTO(DATA,    (_player1tags));
+    if(_playersIncluded & 0b00000010)  encodeLTTO(DATA,    (_player2tags));
+    if(_playersIncluded & 0b00000100)  encodeLTTO(DATA,    (_player3tags));
+    if(_playersIncluded & 0b00001000)  encodeLTTO(DATA,    (_player4tags));
+    if(_playersIncluded & 0b00010000)  encodeLTTO(DATA,    (_player5tags));
+    if(_playersIncluded & 0b00100000)  encodeLTTO(DATA,    (_player6tags));
+    if(_playersIncluded & 0b01000000)  encodeLTTO(DATA,    (_player7tags));
+    if(_playersIncluded & 0b10000000)  encodeLTTO(DATA,    (_player8tags));
     encodeLTTO(CHECKSUM);
 
-    sendIR(irDataArray, sizeof(irDataArray) );
+    sendFrame(irDataArray, txSymbolCount() );
 }
 
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -939,38 +2822,18 @@ void ESP32_IR::taggerTeamReport(uint8_t _teamToReport,     uint8_t _gameID,
 //////////////////////////////////////////////////////////////////////////////////////////
 
 
-int ESP32_IR::encodeTeamAndPlayer(uint8_t _teamNumber, uint8_t _playerNumber)
+int ESP32_IRtxBase::encodeTeamAndPlayer(uint8_t _teamNumber, uint8_t _playerNumber)
 {
-    uint8_t _teamAndPlayer = 0;
+    uint8_t _teamAndPlayer = ESP32_IRroster::encodeTeamAndPlayer(_teamNumber, _playerNumber);
 
-    if(_teamNumber == 0)    //zero-based player number + 8
-    {
-        if(DEBUG)   Serial.println("ESP32_IR::encodeTeamAndPlayer() - Team = 0");
-        _teamAndPlayer = _playerNumber + 7;
-    }
-    else
-    {
-        if(DEBUG)   Serial.print("ESP32_IR::encodeTeamAndPlayer() - Team = ");
-        if(DEBUG)   Serial.println(_teamNumber);
-        _teamAndPlayer = _teamNumber << 3;
-        _teamAndPlayer += (_playerNumber -1);
-    }
     if(DEBUG)   Serial.print("ESP32_IR::encodeTeamAndPlayer() = ");
     if(DEBUG)   Serial.println(_teamAndPlayer);
     return _teamAndPlayer;
 }
 
-//int ESP32_IR::decodeTeamAndPlayer(uint8_t _teamAndPlayerNumber)
-//{
-//    Serial.println("\n\n\n\t\tESP32_IR::decodeTeamAndPlayer() has no code yet !!!!\n\n\n");"
-//    //TODO:
-//}
-
-
-
 //////////////////////////////////////////////////////////////////////////////////////////
 
-int ESP32_IR::convertDecToBCD(int _dec)
+int ESP32_IRtxBase::convertDecToBCD(int _dec)
 {
     if (_dec == 100) return 0xFF;
     return (int) (((_dec/10) << 4) | (_dec %10) );
@@ -978,7 +2841,7 @@ int ESP32_IR::convertDecToBCD(int _dec)
 
 //////////////////////////////////////////////////////////////////////////////////////////
 
-int ESP32_IR::convertBCDtoDec(int _bcd)
+int ESP32_IRtxBase::convertBCDtoDec(int _bcd)
 {
     if (_bcd == 0xFF) return _bcd;
     return (int) (((_bcd >> 4) & 0xF) *10) + (_bcd & 0xF);
@@ -39,13 +39,100 @@ extern "C" {
 #include "driver/rmt.h"
 #include "driver/periph_ctrl.h"
 #include "freertos/semphr.h"
+#include "freertos/ringbuf.h"
 #include "soc/rmt_struct.h"
+#include "esp_timer.h"
 
 #ifdef __cplusplus
 }
 #endif
 
 #define ARRAY_SIZE  150
+#ifndef TX_BUFFER_COUNT
+#define TX_BUFFER_COUNT     2       //Tx frames per instance, so the next frame is encoded while the last one is sent
+#endif
+#ifndef TX_FRAME_CACHE_SIZE
+#define TX_FRAME_CACHE_SIZE 0       //encoded hosting frames remembered per Tx instance (0 = no cache)
+#endif
+#ifndef IR_FRAME_CACHE_SIZE
+#define IR_FRAME_CACHE_SIZE 4       //the same, for the ESP32_IR class - it may be the host
+#endif
+#ifndef RX_RING_BUFFER_SIZE
+#define RX_RING_BUFFER_SIZE 1000    //bytes of RMT Rx ring buffer per receiver
+#endif
+#define MAX_FRAME_PACKETS   13      //Packets per Tx frame tracked for echo suppression (a full team report is 13)
+#define LBT_IDLE_MS         30      //Listen-before-talk: quiet time before the channel is clear (> the gap between packets)
+#define LBT_SLOT_MS         20      //Listen-before-talk: backoff slot
+#define LBT_MIN_WINDOW      4       //Listen-before-talk: backoff slots, doubled after each collision
+#define LBT_MAX_WINDOW      64
+#define LBT_MAX_WAIT_MS     1000
+#define LBT_REPLY_WINDOW_MS 500     //Listen-before-talk: a collision this soon after a held frame went out lost it
+#define LBT_MAX_RETRIES     2       //Listen-before-talk: times a lost frame is sent again
+#define LBT_SENT            1       //Listen-before-talk results
+#define LBT_PENDING         2       //  held, pollListenBeforeTalk() sends it once the channel is clear
+#define LBT_BUSY            0       //  not sent, the channel stayed busy
+#define BEACON_FRAME_SIZE   13      //PreSync + Header + 9 LTAR bits + Gap + End marker
+#define RX_IDLE_US          8000    //RMT Rx idle threshold - a burst is complete this long after its last edge
+#define RX_SHED_WATERMARK   50      //% of the Rx ring buffer in use before beacons and repeats are shed
+#define RX_MAX_BURST_BYTES  (64 * 4 + 8)    //one RMT memory block of items + ring buffer header
+#define RX_DUPLICATE_US     250000  //a repeat of the last tag/beacon inside this is shed under load
+#define RX_GLITCH_FRACTION  4       //a space or mark under 1/4 of the protocol's shortest is a glitch
+#define RX_GLITCH_GAP_US    200     //...for a burst no protocol claims, a space shorter than this splits one mark
+#define RX_GLITCH_MARK_US   200     //...and a mark shorter than this is noise - it is dropped into the space
+#define MAX_MESSAGE_DATA    10      //Data packets in one hosting message (an announce has 9)
+#define MESSAGE_CACHE_SIZE  8       //recent hosting messages remembered per receiver
+#define MESSAGE_CACHE_MS    5000    //a repeat inside this (of the last copy) is flagged, not re-delivered
+#define FRAME_CACHE_PARAMS  12      //parameter bytes a cached Tx frame is keyed on
+#define LATENCY_BUCKETS     24      //log2 uS histogram buckets per latency phase (up to 16 S)
+#define LATENCY_EDGE_QUEUE  8       //burst end times waiting to be matched to ring buffer items
+#define LATENCY_SPAN_US     500     //a queued burst matches a ring buffer item if their lengths are this close
+#define QUALITY_AVERAGE_SHIFT   4   //signal quality rolling averages move 1/16 of the way per frame
+
+//Latency phases
+#define LAT_QUEUE           0       //RMT done -> dequeued (ring buffer wait + polling interval)
+#define LAT_DECODE          1       //dequeued -> decoded
+#define LAT_DELIVER         2       //decoded -> markDelivered() (application)
+#define LAT_TOTAL           3       //last IR edge -> markDelivered()
+#define LAT_PHASES          4
+
+//LTTO timing (uS) and frame sizes - a received duration matches if it is within VARIATION
+#define PRE_SYNC_MARK        3000
+#define PRE_SYNC_SPACE       6000
+#define BEACON_HEADER        6000
+#define TAG_PACKET_HEADER    3000
+#define MARK_SPACE           2000
+#define ZERO_BIT             1000
+#define ONE_BIT              2000
+#define INTERPACKET_DEFAULT 25000
+#define INTERPACKET_TAG     56000
+#define INTERPACKET_CSUM    80000
+#define VARIATION             .20   // 20%
+
+#define BEACON_BIT_COUNT            5
+#define LTAR_BEACON_BIT_COUNT       9
+#define TAG_BIT_COUNT               7
+#define PACKET_BIT_COUNT            9
+#define DATA_BIT_COUNT              8
+#define CHECKSUM_BIT_COUNT          9
+#define CHECKSUM_BIT_SET            256
+
+//Tx frames are stored as 4 bit symbol codes (2 per byte) and expanded into rmt_item32_t
+//by the RMT translator as they are sent. See expandSymbols().
+#define SYMBOL_BYTES(_symbols)  (((_symbols) + 1) / 2)
+#define BEACON_FRAME_BYTES      SYMBOL_BYTES(BEACON_FRAME_SIZE)
+
+#define SYM_END                 0   //end marker (0/0)
+#define SYM_PRE_SYNC            1   //3mS mark, 6mS space
+#define SYM_TAG_HEADER          2   //3mS mark, 2mS space
+#define SYM_BEACON_HEADER       3   //6mS mark, 2mS space
+#define SYM_ZERO_BIT            4   //1mS mark, 2mS space
+#define SYM_ONE_BIT             5   //2mS mark, 2mS space
+#define SYM_GAP_DEFAULT         6   //25mS idle
+#define SYM_GAP_TAG             7   //56mS idle
+#define SYM_GAP_CSUM            8   //80mS idle (expands to 2 items, as 40mS will not fit in 15 bits)
+#define SYM_BRX_START           9   //2mS mark, 0.5mS space
+#define SYM_BRX_ONE             10  //1mS mark, 0.5mS space
+#define SYM_BRX_ZERO            11  //0.5mS mark, 0.5mS space
 
 struct LttoMessage
 {
@@ -56,8 +143,98 @@ struct LttoMessage
     unsigned int    playerNum;      //the taggers player number in the team
     unsigned int    megaTag;        //what strength of Megatag (0-3 are valid).
     bool            isTaggedbeacon; //this beacon was sent as player was just tagged by....
+
+    uint16_t        meanDeviation;  //timing error of the frame's pulses, per mille of nominal (200 = VARIATION)
+    uint16_t        maxDeviation;   //worst single pulse
+
+    int64_t         lastEdgeTime;   //latency tracing, esp_timer uS (0 = not known)
+    int64_t         rxCompleteTime; //RMT idle threshold passed, burst into the ring buffer
+    int64_t         dequeueTime;
+    int64_t         decodeTime;
+    int64_t         deliverTime;
 } ;
 
+//A whole hosting message - Packet, Data..., Checksum - put back together by the receiver.
+struct LttoHostMessage
+{
+    uint8_t         packetID;       //the Packet byte (announce = game type, 16 = request to join, ...)
+    uint8_t         data[MAX_MESSAGE_DATA];
+    uint8_t         dataCount;
+    uint8_t         checksum;
+    uint32_t        hash;           //FNV-1a of packetID and data, the cache key
+};
+
+struct MessageCacheEntry
+{
+    uint32_t        hash;           //checked first, then the message itself
+    uint8_t         packetID;
+    uint8_t         data[MAX_MESSAGE_DATA];
+    uint8_t         dataCount;
+    int64_t         lastSeen;       //0 = empty
+};
+
+//An encoded Tx frame, and what it was encoded from. The symbols are in the Tx instance's cache storage.
+struct TxFrameCacheEntry
+{
+    uint32_t        hash;           //FNV-1a of kind and params, 0 = empty
+    uint8_t         kind;           //which hosting message
+    uint8_t         params[FRAME_CACHE_PARAMS];
+    uint8_t         paramCount;
+    int             symbolCount;
+    uint16_t        checkSum;
+    uint32_t        packetKey[MAX_FRAME_PACKETS];
+    int             packetTime[MAX_FRAME_PACKETS];
+    int             packetCount;
+    uint32_t        lastUsed;
+};
+
+struct LatencyStats
+{
+    uint32_t        count;
+    uint32_t        minUs;
+    uint32_t        maxUs;
+    uint64_t        sumUs;
+    uint32_t        buckets[LATENCY_BUCKETS];   //bucket n holds 2^(n-1) .. 2^n - 1 uS
+};
+
+//Rolling signal quality of one receiver, from the timing of the frames it decodes (any protocol).
+struct SignalQuality
+{
+    uint32_t        frames;         //frames decoded, valid or not
+    uint32_t        invalidFrames;
+    uint16_t        meanDeviation;  //rolling average of the valid frames' meanDeviation, per mille
+    uint16_t        maxDeviation;   //rolling average of the valid frames' maxDeviation
+};
+
+struct LatencySummary
+{
+    uint32_t        count;
+    uint32_t        minUs;
+    uint32_t        avgUs;
+    uint32_t        p99Us;          //upper edge of the bucket holding the 99th percentile
+    uint32_t        maxUs;
+};
+
+//A receive protocol. syncMark/syncSpace are the first mark/space of every frame (uS), and are what
+//the receiver dispatches on. The parser fills in the message, including its timing deviation (which
+//feeds readSignalQuality()), and returns true for a valid frame. shortestMark/shortestSpace are the
+//shortest the protocol sends (uS), and set the glitch filter for its bursts - 0 leaves it at setGlitchFilter()'s.
+typedef bool (*IRframeParser)(const rmt_item32_t *_rawDataIn, int _numItems, LttoMessage &_message);
+
+struct IRprotocol
+{
+    const char     *name;
+    uint16_t        syncMark;
+    uint16_t        syncSpace;
+    IRframeParser   parser;
+    uint16_t        shortestMark;
+    uint16_t        shortestSpace;
+};
+
+class ESP32_IRmedium;          //ESP32_IR_Sim.h
+class ESP32_IRroster;          //ESP32_IR_Roster.h
+class ESP32_IRedgeCapture;     //ESP32_IR_Edge.h
+
 struct hostGameData
 {
     int             playerNum;      //1-24 for hosted games, 0 for non-hosted
@@ -71,26 +248,256 @@ struct taggerData
     int             teamID;
 };
 
-class ESP32_IR {
+//Move-only handle on one burst in an RMT Rx ring buffer. The items are used in place (no copy),
+//and are handed back to the ring buffer when the handle is released or goes out of scope.
+class ESP32_IRrxItem {
+  public:
+    ESP32_IRrxItem();
+    ESP32_IRrxItem(RingbufHandle_t _ringBuf, rmt_item32_t *_items, int _numItems);
+    ESP32_IRrxItem(ESP32_IRrxItem &&_other);
+    ESP32_IRrxItem &operator=(ESP32_IRrxItem &&_other);
+    ESP32_IRrxItem(const ESP32_IRrxItem &) = delete;
+    ESP32_IRrxItem &operator=(const ESP32_IRrxItem &) = delete;
+    ~ESP32_IRrxItem();
+
+    rmt_item32_t        *data()         { return items; }
+    const rmt_item32_t  *data() const   { return items; }
+    int                 size() const    { return numItems; }
+    rmt_item32_t        *begin()        { return items; }
+    rmt_item32_t        *end()          { return items + numItems; }
+    const rmt_item32_t  &operator[](int _index) const { return items[_index]; }
+    explicit operator   bool() const    { return items != NULL; }
+    void                release();
+
+    //Latency tracing - when the burst's last edge was seen, and when it came out of the ring buffer
+    void                stamp(int64_t _lastEdgeTime, int64_t _dequeueTime);
+    int64_t             readLastEdgeTime() const    { return lastEdgeTime; }
+    int64_t             readDequeueTime() const     { return dequeueTime; }
+
+  private:
+    RingbufHandle_t     ringBuf;
+    rmt_item32_t       *items;
+    int                 numItems;
+    int64_t             lastEdgeTime;
+    int64_t             dequeueTime;
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//The Rx and Tx halves are separate classes, so an instance that only receives (or only transmits)
+//carries no buffers for the other role. Capacities are template parameters on the thin
+//ESP32_IRrx<> / ESP32_IRtx<> wrappers, all the code lives in the non-template base classes.
+//ESP32_IR is the original all-in-one class, built from both.
+
+class ESP32_IRrxBase {
   public:
-    ESP32_IR();
     bool    ESP32_IRrxPIN (int _rxPin, int _channel);  //valid channels are 0-7 incl.
-    bool    ESP32_IRtxPIN (int _txPin, int _channel);  //valid channels are 0-7 incl.
     void    initReceive();
-    void    initTransmit();
     void    stopIR();
     int     readIR(unsigned int *data, int maxBuf);
     bool    irAvailabl();
-    void    sendIR(rmt_item32_t data[], int IRlength, bool waitTilDone = false);
-    void    sendLttoIR(char _type, int _data);
-    void    sendLttoIR(String _fullDataString);
 
-        void    sendBrxTest();
+    //Zero-copy receive - the handle can be passed to any number of decoders before it is released.
+    ESP32_IRrxItem  receiveItem();
+    ESP32_IRrxItem  receiveItem(TickType_t _ticksToWait);
+    bool            decodeLTTO(const ESP32_IRrxItem &_rxItem);
+    bool            decodeIR(const ESP32_IRrxItem &_rxItem);      //any registered protocol
+
+    //Protocols readIR()/decodeIR() understand. LTTO/LTAR and BRX are built in.
+    static bool     registerProtocol(const IRprotocol *_protocol);
+    static bool     parseLTTO(const rmt_item32_t *rawDataIn, int numItems, LttoMessage &lttoMessage);
+    static bool     parseBRX(const rmt_item32_t *rawDataIn, int numItems, LttoMessage &lttoMessage);
+
+    //Drop our own transmissions (from any Tx instance) when they bounce back into this receiver
+    void        setEchoSuppression(bool _enabled);
+    uint32_t    readEchoSuppressedCount();
+    void        clearEchoSuppressedCount();
+
+    //Collision detection - the last burst looked like two overlapping transmissions
+    bool        readCollision();
+    uint32_t    readCollisionCount();
+
+    static bool carrierSensed();                        //any receiver (RMT or edge-capture) currently seeing IR
+    static bool collisionSince(int64_t _time);          //any receiver saw a collision after _time (uS, receiver clock)
+
+    //Receive from a simulated medium instead of the RMT (see ESP32_IR_Sim.h)
+    void        attachMedium(ESP32_IRmedium *_medium, int _node);
+    //Receive from a GPIO edge-capture sensor instead of the RMT (see ESP32_IR_Edge.h)
+    void        attachEdgeCapture(ESP32_IRedgeCapture *_capture, int _sensor);
+
+    //Latency tracing - timestamps each decoded message from its last IR edge (a GPIO interrupt on
+    //the Rx pin) to delivery, and keeps min/avg/p99 per LAT_ phase for this receiver.
+    void                setLatencyTracing(bool _enabled);
+    void                markDelivered();                //call once the application has acted on the message
+    LatencySummary      readLatency(int _phase);
+    void                clearLatency();
+    const LttoMessage  &readLttoMessage();
+
+    //Signal quality - each decoded message carries its mean/max timing deviation, and the receiver
+    //keeps rolling averages, eg. to pick the best receiver for a tag or spot a failing sensor.
+    SignalQuality       readSignalQuality();
+    void                clearSignalQuality();
+
+    //Overload handling - once the ring buffer backlog passes _percent full, beacons are dropped unread
+    //and repeats of the last tag/beacon are dropped after decoding, so tags and hosting packets get through.
+    void        setShedWatermark(uint8_t _percent);     //100 = never shed
+    size_t      readBacklog();                          //bytes waiting in the ring buffer
+    size_t      readBacklogPeak();
+    uint32_t    readShedBeaconCount();
+    uint32_t    readShedDuplicateCount();
+    uint32_t    readOverflowCount();                    //times the ring buffer got within a burst of full
+    void        clearOverloadCounters();
+
+    //Glitch filter - before a burst is decoded, a space that is too short (sunlight or a reflection
+    //splitting a mark) is merged back into the mark, and a mark that is too short is dropped. Too short
+    //is under 1/RX_GLITCH_FRACTION of the shortest space/mark of the protocol the burst's sync belongs
+    //to (LTTO 500/250uS, BRX 125/125uS). Runts before the sync, and bursts no protocol claims, are
+    //judged by _maxGapUs/_minMarkUs instead.
+    void        setGlitchFilter(uint16_t _maxGapUs, uint16_t _minMarkUs);   //0, 0 = off, for every protocol
+    uint32_t    readGlitchGapsMerged();
+    uint32_t    readGlitchMarksDropped();
+    uint32_t    readGlitchBurstsRepaired();
+    void        clearGlitchCounters();
+
+    //Hosting messages are put back together as their packets decode. A message already seen inside
+    //the cache window is counted and flagged as repeated, but not made available again. Only the
+    //message is suppressed - readIR()/decodeIR() still return each of its packets as it arrives.
+    bool                    messageAvailable();                 //a new message has completed (clears on read)
+    bool                    readMessageRepeated();              //the last message to complete was a repeat
+    const LttoHostMessage  &readMessage();
+    void                    setMessageCacheWindow(uint32_t _ms);   //0 = every copy is new
+    uint32_t                readMessageCount();                 //messages completed, new and repeated
+    uint32_t                readMessageCacheHits();
+    void                    clearMessageCacheCounters();
 
     int     getLttoMessageTeamNum();
     int     getLttoMessagePlayerNum();
     int     getLttoMessageMegatag();
 
+    char        readMessageType();
+    uint16_t    readRawDataPacket();
+
+    bool        available();
+    void        clearMessageOverwrittenCount();
+    byte        readMessageOverwrittenCount();
+
+    byte        readTeamID();
+    byte        readPlayerID();
+    byte        readShotStrength();
+    char        readBeaconType();
+    bool        readTagReceivedBeacon();
+    byte        readPacketByte();
+    byte        readByteCount();
+    String      readPacketName();
+    String      readDataType();
+    long int    readDataByte();
+    uint8_t     readCheckSumRxByte();
+    bool        readCheckSumOK();
+
+  protected:
+    ESP32_IRrxBase(size_t _ringBufferSize);
+
+  private:
+    int             gpioNum;
+    int             rmtPort;
+    bool            rxInstalled;
+    size_t          ringBufferSize;
+    RingbufHandle_t ringBuf;
+    bool            echoSuppression;
+    uint32_t        echoSuppressedCount;
+    bool            lastRxCollision;
+    uint32_t        collisionCount;
+    ESP32_IRmedium *medium;
+    int             mediumNode;
+    ESP32_IRedgeCapture *edgeCapture;
+    int             edgeSensor;
+
+    bool                latencyTracing;
+    volatile int64_t    lastEdge;                       //written by edgeISR()
+    volatile int64_t    firstEdge;                      //of the burst lastEdge is in
+    int64_t             burstStart[LATENCY_EDGE_QUEUE];
+    int64_t             burstEnd[LATENCY_EDGE_QUEUE];
+    uint8_t             burstEndHead;
+    uint8_t             burstEndCount;
+    portMUX_TYPE        edgeMux;
+    LatencyStats        latency[LAT_PHASES];
+
+    SignalQuality       quality;
+    uint32_t            qualityMeanAverage;             //averages << QUALITY_AVERAGE_SHIFT
+    uint32_t            qualityMaxAverage;
+
+    uint8_t         shedWatermark;
+    bool            overloaded;
+    bool            nearlyFull;
+    size_t          backlogPeak;
+    uint32_t        shedBeaconCount;
+    uint32_t        shedDuplicateCount;
+    uint32_t        overflowCount;
+    char            lastMessageType;                    //for spotting repeats
+    uint16_t        lastMessageData;
+    int64_t         lastMessageTime;
+
+    uint16_t        glitchGapUs;
+    uint16_t        glitchMarkUs;
+    uint32_t        glitchGapsMerged;
+    uint32_t        glitchMarksDropped;
+    uint32_t        glitchBurstsRepaired;
+
+    LttoHostMessage     hostMessage;                    //being assembled, then the last one completed
+    bool                hostMessageOpen;
+    bool                hostMessageNew;
+    bool                hostMessageRepeated;
+    MessageCacheEntry   messageCache[MESSAGE_CACHE_SIZE];
+    uint32_t            messageCacheWindowMs;
+    uint32_t            messageCount;
+    uint32_t            messageCacheHits;
+
+    static int      rxPins[RMT_CHANNEL_MAX];            //installed receivers, by channel, for carrier sense
+    static bool     rxPinInstalled[RMT_CHANNEL_MAX];
+    static int64_t  lastCollisionTime;
+
+    bool    isOwnEcho();
+    bool    acceptMessage(const ESP32_IRrxItem &_rxItem);
+    bool    shedBurst(const ESP32_IRrxItem &_rxItem);
+    bool    shedRepeat();
+    int     filterGlitches(rmt_item32_t *_items, int _numItems);
+    const IRprotocol *glitchProtocol(const rmt_item32_t *_items, int _numItems, int &_syncIndex);
+    void    assembleMessage();
+    bool    messageCacheLookup(const LttoHostMessage &_message, int64_t _now);
+    int64_t rxTime();
+    static void edgeISR(void *_arg);
+    int64_t takeBurstEnd(int64_t _now, const rmt_item32_t *_items, int _numItems);
+    void    traceLatency(const ESP32_IRrxItem &_rxItem);
+    void    recordLatency(int _phase, int64_t _us);
+    void    recordQuality(bool _valid);
+    bool    isCollision(const rmt_item32_t *rawDataIn, int numItems, bool _validPreSync);
+    void    decodeRAW(rmt_item32_t *rawDataIn, int numItems, unsigned int* irDataOut);
+
+    void    getDataIR(rmt_item32_t item, unsigned int *datato, int index);
+
+    bool    decodeIR(const rmt_item32_t *rawDataIn, int numItems);
+    bool    decodeLTTO(const rmt_item32_t *rawDataIn, int numItems, unsigned int *irDataOut);
+    static bool checkData(const rmt_item32_t *rawDataIn, int _index, int _itemToCheck, unsigned int _expectedDuration);
+    static const IRprotocol *findProtocol(const rmt_item32_t *rawDataIn, int numItems);
+    void    checkCollision(bool _validDataPacket, const rmt_item32_t *rawDataIn, int numItems);
+
+    LttoMessage lttoMessage;
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+class ESP32_IRtxBase {
+  public:
+    bool    ESP32_IRtxPIN (int _txPin, int _channel);  //valid channels are 0-7 incl.
+    void    initTransmit();
+    void    stopIR();
+    void    sendIR(rmt_item32_t data[], int IRlength, bool waitTilDone = false);
+    void    sendLttoIR(char _type, int _data);
+    void    sendLttoIR(String _fullDataString);
+    static int  expandSymbols(const uint8_t *_symbols, int _symbolCount, rmt_item32_t *_items, int _maxItems);
+
+        void    sendBrxTest();
+
     //Generic methods
     void        sendIR(char type, uint8_t message);
     bool        sendLTAG(byte tagPower);
@@ -100,12 +507,19 @@ class ESP32_IR {
     bool        sendLTARbeacon(bool tagReceived, bool shieldsActive,
                                byte tagsRemaining, byte unKnown, byte teamID);
 
+    //Beacon autopilot methods (retransmits a pre-encoded beacon from an esp_timer, no loop() involvement)
+    bool        startBeaconAutopilot(uint16_t _intervalMs, byte teamID, byte tagPower, bool _isLtar = false);
+    void        updateBeaconAutopilot(bool tagReceived, bool shieldsActive, byte tagsRemaining, byte teamID);
+    void        stopBeaconAutopilot();
+    bool        isBeaconAutopilotRunning();
+
     //HostGame methods
     int         hostPlayerToGame(uint8_t _teamNumber, uint8_t _playerNumber, uint8_t _gameType,
                                  uint8_t _gameID,     uint8_t _gameLength,   uint8_t _health,
                                  uint8_t _reloads,    uint8_t _shields,      uint8_t _megaTags,
                                  uint8_t _flags1,     uint8_t _flags2,       int8_t _flags3 = -1);
     void        assignPlayer(uint8_t _gameID, uint8_t _taggerID, uint8_t _teamNumber, uint8_t _playerNumber, bool _isLtar = false);
+    int         assignPlayer(uint8_t _gameID, ESP32_IRroster &_roster, uint8_t _taggerID, uint8_t _preferredTeam, bool _isLtar = false);
     void        assignPlayerFailed(uint8_t _gameID, uint8_t _taggerID, bool _isLtar = false);
     void        ltarAssignPlayerSuccess(uint8_t _gameID, uint8_t _teamNumber, uint8_t _playerNumber);
 
@@ -113,7 +527,7 @@ class ESP32_IR {
     void        requestTagReport(uint8_t _gameID, uint8_t _teamNumber, uint8_t _playerNumber, uint8_t _reportRequired);
 
     //Tagger methods
-    void        taggerRequestToJoin(uint8_t _gameID, uint8_t _taggerID, uint8_t _preferredTeam, bool _isLtar = false);
+    int         taggerRequestToJoin(uint8_t _gameID, uint8_t _taggerID, uint8_t _preferredTeam, bool _isLtar = false);
     void        taggerAckPlayerAssign(uint8_t _gameID, uint8_t _taggerID);
     void        taggerTagSummary(uint8_t _gameID,           uint8_t _teamAndPlayerNumber,   uint8_t _totalNumberTagsRx,
                                  uint8_t _survivalMinutes,  uint8_t _survivalSeconds,       uint8_t _zoneTimeMinutes,
@@ -123,59 +537,176 @@ class ESP32_IR {
                                  uint8_t _player3tags,      uint8_t _player4tags,           uint8_t _player5tags,
                                  uint8_t _player6tags,      uint8_t _player7tags,           uint8_t _player8tags);
 
+    //Listen-before-talk with random backoff, for hostPlayerToGame() and taggerRequestToJoin(). Off by default.
+    //Nothing blocks - they hold the frame and return LBT_PENDING, and pollListenBeforeTalk() (call it every
+    //loop) sends it once the channel has been quiet for LBT_IDLE_MS. If the channel stays busy for _maxWaitMs
+    //the frame is dropped and the poll returns LBT_BUSY. A collision in the LBT_REPLY_WINDOW_MS after it went
+    //out sends it again, up to LBT_MAX_RETRIES times. A newer send replaces a frame that is still held.
+    void        setListenBeforeTalk(bool _enabled, uint16_t _maxWaitMs = LBT_MAX_WAIT_MS);
+    int         pollListenBeforeTalk();                 //LBT_PENDING while held, then how the held frame went
+    bool        isListenBeforeTalkPending();
+    void        cancelListenBeforeTalk();
+
+    //Hosting frames (announce, assign, assign failed) are cached by their parameters, so repeating an
+    //unchanged message copies the encoded frame instead of encoding it again. Off until a host turns
+    //it on, and only an ESP32_IRtx<> with a FRAME_CACHE_SIZE has anywhere to keep the frames - turning it
+    //on without one returns false.
+    bool        setFrameCache(bool _enabled);
+    void        clearFrameCache();
+    uint32_t    readFrameCacheHits();
+    uint32_t    readFrameCacheMisses();
+    void        clearFrameCacheCounters();
+
+    //When everything queued so far will have gone out (esp_timer uS, or medium time)
+    int64_t     readTxDoneTime();
+    //Airtime of the last frame sent, uS - the packets, and the gap after each
+    int         readLastFrameAirtime();
+
+    //Transmit into a simulated medium instead of the RMT (see ESP32_IR_Sim.h)
+    void        attachMedium(ESP32_IRmedium *_medium, int _node);
 
-
-    char        readMessageType();
-    uint16_t    readRawDataPacket();
     //void        writeCancelHosting();
     //void        writeHostingInterval(int _interval);
     //int         readHostingInterval();
 
-    bool        available();
-    void        clearMessageOverwrittenCount();
-    byte        readMessageOverwrittenCount();
-
-    byte        readTeamID();
-    byte        readPlayerID();
-    byte        readShotStrength();
-    char        readBeaconType();
-    bool        readTagReceivedBeacon();
-    byte        readPacketByte();
-    byte        readByteCount();
-    String      readPacketName();
-    String      readDataType();
-    long int    readDataByte();
-    uint8_t     readCheckSumRxByte();
-    bool        readCheckSumOK();
+  protected:
+    ESP32_IRtxBase(uint8_t *_frameStorage, int _frameSymbols, int _frameCount,
+                   TxFrameCacheEntry *_cacheEntries, uint8_t *_cacheSymbols, int _cacheSize);
 
   private:
-    rmt_item32_t    irDataArray[ARRAY_SIZE];
-    int             irDataRxArray[50];
+    uint8_t        *txFrames;           //_frameCount frames of SYMBOL_BYTES(_frameSymbols), owned by ESP32_IRtx<>
+    int             txFrameSymbols;
+    int             txFrameCount;
+    uint8_t        *irDataArray;        //the Tx frame currently being encoded (packed symbol codes)
+    int             txFrameIndex;
     int             arrayIndex;
     int             gpioNum;
     int             rmtPort;
+    bool            txInstalled;
     uint16_t        calculatedCheckSum;
+    uint32_t        framePacketKey[MAX_FRAME_PACKETS];     //what is in the frame being encoded, for echo suppression
+    int             framePacketTime[MAX_FRAME_PACKETS];    //airtime of each packet, uS
+    int             framePacketCount;
+    int64_t         txBusyUntil;                            //when the last queued frame will finish
+    int             lastFrameAirtime;
+    bool            listenBeforeTalk;
+    uint16_t        lbtMaxWaitMs;
+    uint16_t        contentionWindow;
+    int64_t         lastContendedSend;
+    uint8_t         lbtState;           //idle, holding a frame, or watching the reply window after sending it
+    int8_t          lbtResult;          //how the last held frame went
+    uint8_t         lbtKind;            //the held frame, as the FRAME_ kind and parameters it is encoded from
+    uint8_t         lbtParams[FRAME_CACHE_PARAMS];
+    uint8_t         lbtRetriesLeft;
+    bool            lbtReplaying;       //sending the held frame, so it isn't held again
+    int64_t         lbtIdleSince;       //time of the last carrier seen
+    int64_t         lbtBackoffUntil;
+    int64_t         lbtGiveUpTime;
+    int64_t         lbtSentTime;
+    ESP32_IRmedium *medium;
+    int             mediumNode;
+    TxFrameCacheEntry *frameCache;      //frameCacheSize entries, owned by ESP32_IRtx<>
+    uint8_t        *frameCacheSymbols;  //frameCacheSize frames of SYMBOL_BYTES(txFrameSymbols), owned by ESP32_IRtx<>
+    int             frameCacheSize;
+    bool            frameCacheEnabled;
+    int             frameCachePending;  //entry the frame being encoded will be stored in, or -1
+    uint32_t        frameCachePendingHash;
+    uint32_t        frameCacheClock;
+    uint32_t        frameCacheHits;
+    uint32_t        frameCacheMisses;
     //bool            cancelHosting;
     //uint16_t        hostingInterval;
 
+    uint8_t             beaconFrame[2][BEACON_FRAME_BYTES];
+    int                 beaconSymbolCount[2];
+    uint32_t            beaconEchoKey[2];
+    int                 beaconAirtime[2];
+    volatile int8_t     activeBeaconFrame;
+    esp_timer_handle_t  beaconTimer;
+    bool                beaconIsLtar;
+    byte                beaconTagPower;
+    SemaphoreHandle_t   txLock;             //held while a frame is handed to the RMT, by sendFrame() and the beacon timer
+    StaticSemaphore_t   txLockBuffer;
+
+    static void beaconTimerCallback(void *_arg);
+    void    encodeBeaconFrame(int _frame, bool _tagReceived, bool _shieldsActive, byte _tagsRemaining, byte _teamID);
+    uint16_t encodeBeaconData(bool _tagReceived, byte _teamID, byte _tagPower);
+    uint16_t encodeLTARbeaconData(bool _tagReceived, bool _shieldsActive, byte _tagsRemaining, byte _unKnown, byte _teamID);
 
-    void    decodeRAW(rmt_item32_t *rawDataIn, int numItems, unsigned int* irDataOut);
-
-    void    getDataIR(rmt_item32_t item, unsigned int *datato, int index);
-    void    buildItem(rmt_item32_t &item,int high_us,int low_us);
-
-    bool    decodeLTTO(rmt_item32_t *rawDataIn, int numItems, unsigned int *irDataOut);
-    bool    checkData(rmt_item32_t *rawDataIn, int _index, int _itemToCheck, unsigned int _expectedDuration);
-    //void encodeLTTO(rmt_item32_t *irDataArrayLocal, char _type, int _data);
     void    encodeLTTO(char _type, uint16_t _data = 0);
+    int     encodeLTTO(uint8_t *_irDataArray, int &_arrayIndex, char _type, uint16_t _data = 0);
+    static void putSymbol(uint8_t *_symbols, int &_index, uint8_t _code);
     int     encodeTeamAndPlayer(uint8_t _teamNumber, uint8_t _playerNumber);
-    bool    decodeTeamAndPlayer(uint8_t _teamAndPlayerNumber);
     void    clearIRdataArray();
+    bool    loadCachedFrame(uint8_t _kind, const uint8_t *_params, int _paramCount);
+    void    storeCachedFrame();
+    int     txSymbolCount();
+    int     holdForClearChannel(uint8_t _kind, const uint8_t *_params, int _paramCount);
+    void    beginContention(int64_t _now);
+    void    sendHeldFrame();
+    bool    channelBusy();
+    bool    collisionSeenSince(int64_t _time);
+    uint32_t txRandom();
+    int64_t txTime();
+    void    sendFrame(const uint8_t *_symbols, int _symbolCount, bool waitTilDone = false);
+    static void lttoSymbolTranslator(const void *_src, rmt_item32_t *_dest, size_t _srcSize,
+                                     size_t _wantedNum, size_t *_translatedSize, size_t *_itemNum);
 
     int     convertDecToBCD(int _dec);
     int     convertBCDtoDec(int _bcd);
+};
 
-    LttoMessage lttoMessage;
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//Receive only. RING_BUFFER_SIZE is the RMT driver's Rx ring buffer, in bytes.
+template <size_t RING_BUFFER_SIZE = RX_RING_BUFFER_SIZE>
+class ESP32_IRrx : public ESP32_IRrxBase {
+  public:
+    ESP32_IRrx() : ESP32_IRrxBase(RING_BUFFER_SIZE) {}
+};
+
+//Frame cache storage for ESP32_IRtx<>. A cache size of 0 holds nothing.
+template <int CACHE_SIZE, int FRAME_BYTES>
+struct TxFrameCache
+{
+    static TxFrameCacheEntry   *entryList(TxFrameCache *_cache)    { return &_cache->entries[0]; }
+    static uint8_t             *symbolList(TxFrameCache *_cache)   { return &_cache->symbols[0][0]; }
+
+    TxFrameCacheEntry   entries[CACHE_SIZE];
+    uint8_t             symbols[CACHE_SIZE][FRAME_BYTES];
+};
+
+template <int FRAME_BYTES>
+struct TxFrameCache<0, FRAME_BYTES>
+{
+    static TxFrameCacheEntry   *entryList(TxFrameCache *)          { return NULL; }
+    static uint8_t             *symbolList(TxFrameCache *)         { return NULL; }
+};
+
+//Transmit only. FRAME_SYMBOLS is the longest message in symbols, FRAME_COUNT is how many
+//frames can be queued before a send has to wait for the RMT. FRAME_CACHE_SIZE is how many
+//encoded hosting frames setFrameCache() can keep - a host wants 4, a tagger needs none.
+template <int FRAME_SYMBOLS = ARRAY_SIZE, int FRAME_COUNT = TX_BUFFER_COUNT, int FRAME_CACHE_SIZE = TX_FRAME_CACHE_SIZE>
+class ESP32_IRtx : public ESP32_IRtxBase {
+  public:
+    ESP32_IRtx() : ESP32_IRtxBase(&frameStorage[0][0], FRAME_SYMBOLS, FRAME_COUNT,
+                                  FrameCache::entryList(&frameCache), FrameCache::symbolList(&frameCache), FRAME_CACHE_SIZE) {}
+
+  private:
+    uint8_t     frameStorage[FRAME_COUNT][SYMBOL_BYTES(FRAME_SYMBOLS)];
+    typedef TxFrameCache<FRAME_CACHE_SIZE, SYMBOL_BYTES(FRAME_SYMBOLS)> FrameCache;
+    FrameCache  frameCache;
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//The original class - can be set up as either Rx or Tx, so it carries both, and room for
+//IR_FRAME_CACHE_SIZE hosting frames.
+class ESP32_IR : public ESP32_IRrx<>, public ESP32_IRtx<ARRAY_SIZE, TX_BUFFER_COUNT, IR_FRAME_CACHE_SIZE> {
+  public:
+    ESP32_IR();
+    void    stopIR();
+    void    attachMedium(ESP32_IRmedium *_medium, int _node);
 };
 
 #endif /* ESP32_IR_LTTO_H_ */
@@ -0,0 +1,331 @@
+ /* Copyright (c) 2018 Richie Mickan. All Rights Reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>. *
+ */
+
+#include "Arduino.h"
+#include "ESP32_IR_Pipeline.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#ifdef __cplusplus
+}
+#endif
+
+////////////////////////////////////
+#define         DEBUG       false
+////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+ESP32_IRpipeline::ESP32_IRpipeline()
+{
+    rxCount         = 0;
+    txCount         = 0;
+    rxTask          = NULL;
+    txTask          = NULL;
+    running         = false;
+    tasksRunning    = 0;
+    clearStats();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+ESP32_IRpipeline::~ESP32_IRpipeline()
+{
+    end();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+bool ESP32_IRpipeline::attach(ESP32_IRrxBase &_rx)
+{
+    if(rxCount >= MAX_PIPELINE_RX || running)   return false;
+    rxList[rxCount]         = &_rx;
+    rxMessageCount[rxCount] = _rx.readMessageCount();
+    rxCount++;
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+bool ESP32_IRpipeline::begin(int _rxCore, int _txCore, int _priority)
+{
+    if(running) return false;
+    running         = true;
+    tasksRunning    = 2;
+
+    TaskHandle_t _rxHandle = NULL;
+    TaskHandle_t _txHandle = NULL;
+    bool _rxOk = xTaskCreatePinnedToCore(rxTaskLoop, "IRrx", PIPELINE_STACK_SIZE, this, _priority, &_rxHandle, _rxCore) == pdPASS;
+    if(!_rxOk)  tasksRunning--;
+    bool _txOk = xTaskCreatePinnedToCore(txTaskLoop, "IRtx", PIPELINE_STACK_SIZE, this, _priority, &_txHandle, _txCore) == pdPASS;
+    if(!_txOk)  tasksRunning--;
+    rxTask = _rxHandle;
+    txTask = _txHandle;
+
+    if(!_rxOk || !_txOk)
+    {
+        if(DEBUG)   Serial.println("ESP32_IRpipeline::begin() - could not create the tasks");
+        end();
+        return false;
+    }
+
+    if(DEBUG)
+    {
+        Serial.print("ESP32_IRpipeline::begin() - Rx core ");   Serial.print(_rxCore);
+        Serial.print(", Tx core ");                             Serial.println(_txCore);
+    }
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRpipeline::end()
+{
+    if(!running && rxTask == NULL && txTask == NULL)    return;
+    running = false;
+    wakeTx();
+
+    //The tasks signal once they are out of their loops, then wait to be deleted here - so the Tx
+    //task is still there for wakeTx(), however quickly it sees running go false.
+    while(tasksRunning > 0) vTaskDelay(1);
+    if(rxTask != NULL)  vTaskDelete((TaskHandle_t)rxTask);
+    if(txTask != NULL)  vTaskDelete((TaskHandle_t)txTask);
+    rxTask = NULL;
+    txTask = NULL;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+bool ESP32_IRpipeline::isRunning()
+{
+    return running;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRpipeline::idle()
+{
+    vTaskDelay(1);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRpipeline::wakeTx()
+{
+    if(txTask != NULL)  xTaskNotifyGive((TaskHandle_t)txTask);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//Once out of its loop, a task waits here for end() to delete it.
+void ESP32_IRpipeline::taskDone()
+{
+    tasksRunning--;
+    while(true) vTaskSuspend(NULL);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRpipeline::rxTaskLoop(void *_arg)
+{
+    ESP32_IRpipeline *_pipeline = (ESP32_IRpipeline*)_arg;
+
+    while(_pipeline->running)
+    {
+        if(!_pipeline->pollReceivers()) idle();
+    }
+    _pipeline->taskDone();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//Takes everything waiting in every receiver. Returns false if there was nothing.
+bool ESP32_IRpipeline::pollReceivers()
+{
+    bool _received = false;
+
+    for(int _rx = 0; _rx < rxCount; _rx++)
+    {
+        ESP32_IRrxBase *_receiver = rxList[_rx];
+        while(true)
+        {
+            ESP32_IRrxItem _rxItem = _receiver->receiveItem(0);
+            if(!_rxItem)    break;
+            _received = true;
+            bursts++;
+            if(!_receiver->decodeIR(_rxItem))   continue;
+
+            IRpipelineMessage _message;
+            _message.receiver               = _rx;
+            _message.message                = _receiver->readLttoMessage();
+            _message.hostMessageDone        = _receiver->readMessageCount() != rxMessageCount[_rx];
+            _message.hostMessageRepeated    = false;
+            if(_message.hostMessageDone)
+            {
+                rxMessageCount[_rx]             = _receiver->readMessageCount();
+                _message.hostMessageRepeated    = _receiver->readMessageRepeated();
+                _message.hostMessage            = _receiver->readMessage();
+                _receiver->messageAvailable();      //clear it, the pipeline has delivered it
+            }
+
+            if(rxQueue.push(_message))  messages++;
+            else                        rxDropped++;
+        }
+    }
+    return _received;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRpipeline::txTaskLoop(void *_arg)
+{
+    ESP32_IRpipeline *_pipeline = (ESP32_IRpipeline*)_arg;
+    IRpipelineTxJob _job;
+
+    while(_pipeline->running)
+    {
+        if(!_pipeline->txQueue.pop(_job))
+        {
+            //Held frames are checked every tick, otherwise sleep until something is queued.
+            bool _holding = _pipeline->pollHeldFrames();
+            ulTaskNotifyTake(pdTRUE, _holding ? 1 : pdMS_TO_TICKS(10));
+            continue;
+        }
+        _job.job(*_job.tx, _job.arg);
+        _pipeline->sends++;
+        _pipeline->trackTx(_job.tx);
+    }
+    _pipeline->taskDone();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//Remembers a Tx the Tx task has sent on, so its held frames get polled.
+void ESP32_IRpipeline::trackTx(ESP32_IRtxBase *_tx)
+{
+    for(int index = 0; index < txCount; index++)
+    {
+        if(txList[index] == _tx)    return;
+    }
+    if(txCount >= MAX_PIPELINE_TX)  return;
+    txList[txCount]         = _tx;
+    txLbtResult[txCount]    = LBT_SENT;
+    txCount++;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//Polls listen-before-talk on every Tx sent on, so a held frame goes out (or gives up) without
+//blocking the queue. Returns true while any frame is still held.
+bool ESP32_IRpipeline::pollHeldFrames()
+{
+    bool _holding = false;
+
+    for(int index = 0; index < txCount; index++)
+    {
+        int _result = txList[index]->pollListenBeforeTalk();
+        if(_result == LBT_BUSY && txLbtResult[index] == LBT_PENDING)    txBusy++;
+        txLbtResult[index] = _result;
+        if(_result == LBT_PENDING)  _holding = true;
+    }
+    return _holding;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+bool ESP32_IRpipeline::available()
+{
+    return !rxQueue.empty();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+bool ESP32_IRpipeline::read(IRpipelineMessage &_message)
+{
+    return rxQueue.pop(_message);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+bool ESP32_IRpipeline::queueTx(ESP32_IRtxBase &_tx, IRtxJob _job, uint32_t _arg)
+{
+    IRpipelineTxJob _entry = { &_tx, _job, _arg };
+    if(!txQueue.push(_entry))
+    {
+        txDropped++;
+        return false;
+    }
+    wakeTx();
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRpipeline::sendTagJob(ESP32_IRtxBase &_tx, uint32_t _arg)
+{
+    _tx.sendTag(_arg & 0xFF, (_arg >> 8) & 0xFF, (_arg >> 16) & 0xFF);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+bool ESP32_IRpipeline::queueTag(ESP32_IRtxBase &_tx, byte _teamID, byte _playerID, byte _tagPower)
+{
+    return queueTx(_tx, sendTagJob, _teamID | (_playerID << 8) | ((uint32_t)_tagPower << 16));
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRpipeline::sendPacketJob(ESP32_IRtxBase &_tx, uint32_t _arg)
+{
+    _tx.sendLttoIR((char)(_arg & 0xFF), _arg >> 8);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+bool ESP32_IRpipeline::queuePacket(ESP32_IRtxBase &_tx, char _type, uint16_t _data)
+{
+    return queueTx(_tx, sendPacketJob, (uint8_t)_type | ((uint32_t)_data << 8));
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+IRpipelineStats ESP32_IRpipeline::readStats()
+{
+    IRpipelineStats _stats;
+    _stats.bursts       = bursts;
+    _stats.messages     = messages;
+    _stats.rxDropped    = rxDropped;
+    _stats.sends        = sends;
+    _stats.txDropped    = txDropped;
+    _stats.txBusy       = txBusy;
+    return _stats;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRpipeline::clearStats()
+{
+    bursts      = 0;
+    messages    = 0;
+    rxDropped   = 0;
+    sends       = 0;
+    txDropped   = 0;
+    txBusy      = 0;
+}
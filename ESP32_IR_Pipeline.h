@@ -0,0 +1,174 @@
+ /* Copyright (c) 2018 Richie Mickan. All Rights Reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>. *
+ */
+
+/* Pipeline mode - the IR work moves off the Arduino loop.
+ * An Rx task (pinned to rxCore, by default core 0 - the loop runs on core 1) receives and decodes
+ * every attached receiver, and queues each message it accepts. The sketch reads them with read().
+ * A Tx task (pinned to txCore) sends what the sketch queues with queueTag()/queuePacket()/queueTx(),
+ * so a send never blocks the loop. Each queue has one producer and one consumer, and is lock free.
+ *
+ *  ESP32_IRpipeline    pipeline;
+ *  pipeline.attach(irFwd);     pipeline.attach(irBack);
+ *  pipeline.begin();
+ *  ...
+ *  IRpipelineMessage   msg;
+ *  while(pipeline.read(msg))   handle(msg.receiver, msg.message);
+ *  pipeline.queueTag(irTags, team, player, power);
+ *
+ * Once a receiver is attached, only the Rx task may use it - read its messages from the pipeline.
+ *
+ * With listen-before-talk on, a hosting send the Tx task runs may be held for a clear channel. The
+ * Tx task doesn't wait for it - it polls pollListenBeforeTalk() on every Tx it has sent on, between
+ * jobs, and counts the held frames that gave up in txBusy. Leave those polls to the Tx task.
+ */
+
+#ifndef ESP32_IR_PIPELINE_H_
+#define ESP32_IR_PIPELINE_H_
+
+#include "ESP32_IR_LTTO.h"
+#include <atomic>
+
+#define MAX_PIPELINE_RX         8
+#define MAX_PIPELINE_TX         8       //Tx instances the Tx task polls listen-before-talk on
+#define PIPELINE_RX_QUEUE       32      //decoded messages waiting for the sketch (power of 2)
+#define PIPELINE_TX_QUEUE       16      //sends waiting for the Tx task (power of 2)
+#define PIPELINE_RX_CORE        0
+#define PIPELINE_TX_CORE        0
+#define PIPELINE_PRIORITY       5       //above the Arduino loop (1), below WiFi/BT
+#define PIPELINE_STACK_SIZE     4096
+
+//Single producer, single consumer ring. One slot is always left empty, so it holds SIZE - 1.
+template <typename T, int SIZE>
+class IRspscQueue {
+  public:
+    IRspscQueue() : head(0), tail(0) {}
+
+    bool push(const T &_item)
+    {
+        uint32_t _head = head.load(std::memory_order_relaxed);
+        uint32_t _next = (_head + 1) & (SIZE - 1);
+        if(_next == tail.load(std::memory_order_acquire))   return false;
+        slots[_head] = _item;
+        head.store(_next, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T &_item)
+    {
+        uint32_t _tail = tail.load(std::memory_order_relaxed);
+        if(_tail == head.load(std::memory_order_acquire))   return false;
+        _item = slots[_tail];
+        tail.store((_tail + 1) & (SIZE - 1), std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const
+    {
+        return tail.load(std::memory_order_acquire) == head.load(std::memory_order_acquire);
+    }
+
+  private:
+    T                       slots[SIZE];
+    std::atomic<uint32_t>   head;       //written by the producer
+    std::atomic<uint32_t>   tail;       //written by the consumer
+};
+
+struct IRpipelineMessage
+{
+    uint8_t         receiver;           //order the receiver was attach()ed in
+    LttoMessage     message;
+    bool            hostMessageDone;    //this packet completed a hosting message
+    bool            hostMessageRepeated;
+    LttoHostMessage hostMessage;
+};
+
+//A send, run on the Tx task. _arg is whatever the job needs packed into 32 bits.
+typedef void (*IRtxJob)(ESP32_IRtxBase &_tx, uint32_t _arg);
+
+struct IRpipelineTxJob
+{
+    ESP32_IRtxBase *tx;
+    IRtxJob         job;
+    uint32_t        arg;
+};
+
+struct IRpipelineStats
+{
+    uint32_t        bursts;             //received by the Rx task
+    uint32_t        messages;           //decoded, accepted and queued
+    uint32_t        rxDropped;          //the sketch fell PIPELINE_RX_QUEUE behind
+    uint32_t        sends;              //run by the Tx task
+    uint32_t        txDropped;          //the Tx queue was full
+    uint32_t        txBusy;             //held for listen-before-talk, and never found a clear channel
+};
+
+class ESP32_IRpipeline {
+  public:
+    ESP32_IRpipeline();
+    ~ESP32_IRpipeline();
+
+    bool        attach(ESP32_IRrxBase &_rx);        //before begin()
+    bool        begin(int _rxCore = PIPELINE_RX_CORE, int _txCore = PIPELINE_TX_CORE,
+                      int _priority = PIPELINE_PRIORITY);
+    void        end();                              //stops both tasks, and waits for them
+    bool        isRunning();
+
+    //Sketch side (one task)
+    bool        available();
+    bool        read(IRpipelineMessage &_message);
+    bool        queueTx(ESP32_IRtxBase &_tx, IRtxJob _job, uint32_t _arg);
+    bool        queueTag(ESP32_IRtxBase &_tx, byte _teamID, byte _playerID, byte _tagPower);
+    bool        queuePacket(ESP32_IRtxBase &_tx, char _type, uint16_t _data);
+
+    IRpipelineStats readStats();
+    void            clearStats();
+
+  private:
+    ESP32_IRrxBase     *rxList[MAX_PIPELINE_RX];
+    uint32_t            rxMessageCount[MAX_PIPELINE_RX];
+    int                 rxCount;
+
+    ESP32_IRtxBase     *txList[MAX_PIPELINE_TX];   //Tx task only
+    int8_t              txLbtResult[MAX_PIPELINE_TX];
+    int                 txCount;
+
+    IRspscQueue<IRpipelineMessage, PIPELINE_RX_QUEUE>   rxQueue;
+    IRspscQueue<IRpipelineTxJob,   PIPELINE_TX_QUEUE>   txQueue;
+
+    std::atomic<bool>       running;
+    std::atomic<int>        tasksRunning;
+    void                   *rxTask;         //TaskHandle_t
+    void                   *txTask;
+
+    std::atomic<uint32_t>   bursts;
+    std::atomic<uint32_t>   messages;
+    std::atomic<uint32_t>   rxDropped;
+    std::atomic<uint32_t>   sends;
+    std::atomic<uint32_t>   txDropped;
+    std::atomic<uint32_t>   txBusy;
+
+    static void rxTaskLoop(void *_arg);
+    static void txTaskLoop(void *_arg);
+    bool        pollReceivers();
+    static void idle();
+    void        wakeTx();
+    void        taskDone();
+    void        trackTx(ESP32_IRtxBase *_tx);
+    bool        pollHeldFrames();
+    static void sendTagJob(ESP32_IRtxBase &_tx, uint32_t _arg);
+    static void sendPacketJob(ESP32_IRtxBase &_tx, uint32_t _arg);
+};
+
+#endif /* ESP32_IR_PIPELINE_H_ */
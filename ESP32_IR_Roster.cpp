@@ -0,0 +1,228 @@
+ /* Copyright (c) 2018 Richie Mickan. All Rights Reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>. *
+ */
+
+#include "Arduino.h"
+#include "ESP32_IR_Roster.h"
+
+////////////////////////////////////
+#define         DEBUG       false
+////////////////////////////////////
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+ESP32_IRroster::ESP32_IRroster(bool _teamGame, uint8_t _teams)
+{
+    setGameType(_teamGame, _teams);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRroster::setGameType(bool _teamGame, uint8_t _teams)
+{
+    teamGame    = _teamGame;
+    teams       = _teamGame ? _teams : 0;
+    if(teams > MAX_ROSTER_TEAMS)        teams = MAX_ROSTER_TEAMS;
+    if(_teamGame && teams == 0)         teams = 1;
+    clear();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRroster::clear()
+{
+    memset(slots,       0,              sizeof(slots));
+    memset(taggerIndex, ROSTER_NO_SLOT, sizeof(taggerIndex));
+    memset(playerIndex, ROSTER_NO_SLOT, sizeof(playerIndex));
+    memset(playersUsed, 0,              sizeof(playersUsed));
+    memset(teamCount,   0,              sizeof(teamCount));
+    slotsUsed   = 0;
+    playerCount = 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//A tagger that is already on the roster keeps its slot (e.g. it asked to join again after its ack was lost).
+int ESP32_IRroster::addTagger(uint8_t _taggerID, uint8_t _preferredTeam)
+{
+    int _slot = findTagger(_taggerID);
+    if(_slot >= 0)  return _slot;
+
+    uint8_t _team       = pickTeam(_preferredTeam);
+    int     _maxPlayers = teamGame ? ROSTER_TEAM_SIZE : MAX_ROSTER_PLAYERS;
+    if(slotsUsed == (1UL << MAX_ROSTER_PLAYERS) - 1 || teamCount[_team] >= _maxPlayers)
+    {
+        if(DEBUG)   Serial.println("ESP32_IRroster::addTagger() - game is full");
+        return -1;
+    }
+
+    _slot = __builtin_ctz(~slotsUsed);
+    uint8_t _player = __builtin_ctz(~playersUsed[_team]) + 1;
+
+    RosterSlot &_entry      = slots[_slot];
+    _entry.taggerID         = _taggerID;
+    _entry.teamNumber       = _team;
+    _entry.playerNumber     = _player;
+    _entry.teamAndPlayer    = encodeTeamAndPlayer(_team, _player);
+    _entry.state            = SLOT_ASSIGNED;
+
+    slotsUsed                               |= 1UL << _slot;
+    playersUsed[_team]                      |= 1UL << (_player - 1);
+    teamCount[_team]++;
+    playerCount++;
+    taggerIndex[_taggerID]                  = _slot;
+    playerIndex[_entry.teamAndPlayer & 0x1F] = _slot;
+
+    if(DEBUG)
+    {
+        Serial.print("ESP32_IRroster::addTagger() - TaggerID ");    Serial.print(_taggerID);
+        Serial.print(" = Team ");                                   Serial.print(_team);
+        Serial.print(", Player ");                                  Serial.println(_player);
+    }
+    return _slot;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+bool ESP32_IRroster::removeTagger(uint8_t _taggerID)
+{
+    int _slot = findTagger(_taggerID);
+    if(_slot < 0)   return false;
+
+    RosterSlot &_entry = slots[_slot];
+    slotsUsed                           &= ~(1UL << _slot);
+    playersUsed[_entry.teamNumber]      &= ~(1UL << (_entry.playerNumber - 1));
+    teamCount[_entry.teamNumber]--;
+    playerCount--;
+    taggerIndex[_taggerID]                      = ROSTER_NO_SLOT;
+    playerIndex[_entry.teamAndPlayer & 0x1F]    = ROSTER_NO_SLOT;
+    memset(&_entry, 0, sizeof(_entry));
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+bool ESP32_IRroster::setState(uint8_t _taggerID, uint8_t _state)
+{
+    int _slot = findTagger(_taggerID);
+    if(_slot < 0 || _state == SLOT_FREE)    return false;
+    slots[_slot].state = _state;
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+int ESP32_IRroster::findTagger(uint8_t _taggerID)
+{
+    uint8_t _slot = taggerIndex[_taggerID];
+    return (_slot == ROSTER_NO_SLOT) ? -1 : _slot;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+int ESP32_IRroster::findTeamAndPlayer(uint8_t _teamAndPlayer)
+{
+    uint8_t _slot = playerIndex[_teamAndPlayer & 0x1F];
+    return (_slot == ROSTER_NO_SLOT) ? -1 : _slot;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+const RosterSlot &ESP32_IRroster::readSlot(int _slot)
+{
+    if(_slot < 0 || _slot >= MAX_ROSTER_PLAYERS)    _slot = 0;
+    return slots[_slot];
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+uint8_t ESP32_IRroster::readPlayerCount()
+{
+    return playerCount;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+uint8_t ESP32_IRroster::readTeamCount(uint8_t _teamNumber)
+{
+    if(_teamNumber > MAX_ROSTER_TEAMS)  return 0;
+    return teamCount[_teamNumber];
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+uint8_t ESP32_IRroster::readStateCount(uint8_t _state)
+{
+    uint8_t _count = 0;
+    for(uint32_t _used = slotsUsed; _used; _used &= _used - 1)
+    {
+        if(slots[__builtin_ctz(_used)].state == _state) _count++;
+    }
+    return _count;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//The preferred team, unless that would put it two players ahead of the smallest team.
+uint8_t ESP32_IRroster::pickTeam(uint8_t _preferredTeam)
+{
+    if(!teamGame)   return 0;
+
+    uint8_t _smallest = 1;
+    for(uint8_t _team = 2; _team <= teams; _team++)
+    {
+        if(teamCount[_team] < teamCount[_smallest]) _smallest = _team;
+    }
+
+    if(_preferredTeam >= 1 && _preferredTeam <= teams
+       && teamCount[_preferredTeam] < ROSTER_TEAM_SIZE
+       && teamCount[_preferredTeam] <= teamCount[_smallest])
+    {
+        return _preferredTeam;
+    }
+    return _smallest;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+uint8_t ESP32_IRroster::encodeTeamAndPlayer(uint8_t _teamNumber, uint8_t _playerNumber)
+{
+    if(_teamNumber == 0)    return _playerNumber + 7;       //zero-based player number + 8
+    return (_teamNumber << 3) + (_playerNumber - 1);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+bool ESP32_IRroster::decodeTeamAndPlayer(uint8_t _teamAndPlayer, bool _teamGame, uint8_t &_teamNumber, uint8_t &_playerNumber)
+{
+    _teamAndPlayer &= 0x1F;
+    if(_teamAndPlayer < 8)
+    {
+        _teamNumber     = 0;
+        _playerNumber   = 0;
+        return false;
+    }
+
+    if(_teamGame)
+    {
+        _teamNumber     = _teamAndPlayer >> 3;
+        _playerNumber   = (_teamAndPlayer & 0x07) + 1;
+    }
+    else
+    {
+        _teamNumber     = 0;
+        _playerNumber   = _teamAndPlayer - 7;
+    }
+    return true;
+}
@@ -0,0 +1,85 @@
+ /* Copyright (c) 2018 Richie Mickan. All Rights Reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>. *
+ */
+
+/* The host's roster of players in a game.
+ * TaggerIDs and team/player codes map straight to a slot through index tables, so lookups during
+ * hosting and debrief don't search. New players are put on the smallest team (or their preferred
+ * team, if that keeps the teams within one player of each other).
+ */
+
+#ifndef ESP32_IR_ROSTER_H_
+#define ESP32_IR_ROSTER_H_
+
+#include "Arduino.h"
+
+#define MAX_ROSTER_PLAYERS      24
+#define MAX_ROSTER_TEAMS        3
+#define ROSTER_TEAM_SIZE        8
+#define ROSTER_NO_SLOT          0xFF
+
+//Join state of a slot
+#define SLOT_FREE               0
+#define SLOT_ASSIGNED           1       //assignPlayer() sent, waiting for the tagger's ack
+#define SLOT_JOINED             2       //tagger acked
+#define SLOT_REPORTED           3       //debrief received
+
+struct RosterSlot
+{
+    uint8_t     taggerID;
+    uint8_t     teamNumber;             //0 for a solo game
+    uint8_t     playerNumber;           //1-8 in a team, 1-24 solo
+    uint8_t     teamAndPlayer;          //as sent over IR
+    uint8_t     state;
+};
+
+class ESP32_IRroster {
+  public:
+    ESP32_IRroster(bool _teamGame = true, uint8_t _teams = MAX_ROSTER_TEAMS);
+
+    void        clear();
+    void        setGameType(bool _teamGame, uint8_t _teams = MAX_ROSTER_TEAMS);    //also clears
+
+    int         addTagger(uint8_t _taggerID, uint8_t _preferredTeam = 0);   //slot, or -1 if the game is full
+    bool        removeTagger(uint8_t _taggerID);
+    bool        setState(uint8_t _taggerID, uint8_t _state);
+
+    int         findTagger(uint8_t _taggerID);                  //slot, or -1
+    int         findTeamAndPlayer(uint8_t _teamAndPlayer);      //slot, or -1 (for debrief)
+    const RosterSlot &readSlot(int _slot);
+
+    uint8_t     readPlayerCount();
+    uint8_t     readTeamCount(uint8_t _teamNumber);
+    uint8_t     readStateCount(uint8_t _state);
+
+    //Team 1-3 is (team << 3) + player - 1. Solo (team 0) players are player + 7, which overlaps
+    //team 1, so decoding needs to know which kind of game it is.
+    static uint8_t  encodeTeamAndPlayer(uint8_t _teamNumber, uint8_t _playerNumber);
+    static bool     decodeTeamAndPlayer(uint8_t _teamAndPlayer, bool _teamGame, uint8_t &_teamNumber, uint8_t &_playerNumber);
+
+  private:
+    RosterSlot  slots[MAX_ROSTER_PLAYERS];
+    uint8_t     taggerIndex[256];                   //taggerID -> slot
+    uint8_t     playerIndex[32];                    //teamAndPlayer -> slot
+    uint32_t    slotsUsed;                          //bit n = slots[n] in use
+    uint32_t    playersUsed[MAX_ROSTER_TEAMS + 1];  //bit n = player n+1 taken, [0] is solo
+    uint8_t     teamCount[MAX_ROSTER_TEAMS + 1];
+    uint8_t     playerCount;
+    bool        teamGame;
+    uint8_t     teams;
+
+    uint8_t     pickTeam(uint8_t _preferredTeam);
+};
+
+#endif /* ESP32_IR_ROSTER_H_ */
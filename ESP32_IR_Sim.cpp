@@ -0,0 +1,569 @@
+ /* Copyright (c) 2018 Richie Mickan. All Rights Reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>. *
+ */
+
+#include "Arduino.h"
+#include "ESP32_IR_Sim.h"
+
+////////////////////////////////////
+#define         DEBUG       false
+////////////////////////////////////
+
+#define ARENA_GAME_TYPE             0x02
+#define ARENA_ANNOUNCE_INTERVAL     1500000     //uS between hosting announces
+#define ARENA_BEACON_INTERVAL       500000
+#define ARENA_TAG_INTERVAL          2000000     //average uS between tags, per tagger
+#define ARENA_JOIN_DELAY_MAX        3000000     //players press join at some point within this time of an announce
+#define ARENA_ASSIGN_RETRY          2000000     //host sends an unacked assign again this often
+#define ARENA_HOST_HOLDOFF          1000000     //host doesn't announce over hosting traffic
+#define ARENA_LBT_MAX_WAIT_MS       10000       //a join/assign/ack exchange is over 1S of air, so a lobby is busy for a while
+
+//////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////
+
+ESP32_IRmedium::ESP32_IRmedium(int _nodeCount, uint32_t _seed)
+{
+    if(_nodeCount > MAX_SIM_NODES)  _nodeCount = MAX_SIM_NODES;
+    nodeCount       = _nodeCount;
+    simTime         = 0;
+    lastStepUs      = 0;
+    randomState     = _seed ? _seed : 1;
+    links           = new SimLink[nodeCount * nodeCount];
+    marks           = new SimMark[nodeCount * SIM_MARKS_PER_NODE];
+    markCount       = new int[nodeCount];
+    lastCollision   = new int64_t[nodeCount];
+    rxBurst         = new rmt_item32_t[nodeCount * SIM_MAX_BURST_ITEMS];
+    packetsSent     = 0;
+    packetsLost     = 0;
+    burstsDelivered = 0;
+    collisions      = 0;
+
+    for(int index = 0; index < nodeCount; index++)
+    {
+        markCount[index]        = 0;
+        lastCollision[index]    = -1;
+    }
+    setAllLinks(0, 0);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+ESP32_IRmedium::~ESP32_IRmedium()
+{
+    delete[] links;
+    delete[] marks;
+    delete[] markCount;
+    delete[] lastCollision;
+    delete[] rxBurst;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRmedium::setLink(int _fromNode, int _toNode, float _lossRate, uint32_t _delayUs)
+{
+    if(_fromNode >= nodeCount || _toNode >= nodeCount)  return;
+    links[_fromNode * nodeCount + _toNode].lossPerMille = _lossRate * 1000;
+    links[_fromNode * nodeCount + _toNode].delayUs      = _delayUs;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRmedium::setAllLinks(float _lossRate, uint32_t _delayUs)
+{
+    for(int _from = 0; _from < nodeCount; _from++)
+    {
+        for(int _to = 0; _to < nodeCount; _to++)
+        {
+            //A node does not hear itself, unless a link is set up for it.
+            setLink(_from, _to, (_from == _to) ? 1.0 : _lossRate, _delayUs);
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+int64_t ESP32_IRmedium::now()
+{
+    return simTime;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRmedium::advance(uint32_t _us)
+{
+    simTime    += _us;
+    lastStepUs  = _us;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t ESP32_IRmedium::random()
+{
+    //xorshift32 - repeatable runs for a given seed.
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+bool ESP32_IRmedium::carrierSensed(int _node)
+{
+    if(_node < 0 || _node >= nodeCount) return false;
+
+    //A mark that has only just started hasn't come out of the receiver yet - so two nodes that
+    //start within SIM_CARRIER_DETECT_US of each other both see a clear channel, and collide.
+    //A real loop polls far more often than the step, so any mark seen during it counts - sampling
+    //only at the step would miss every 1mS bit when the step is 1mS, and a packet of them looks idle.
+    int64_t  _from  = simTime - lastStepUs;
+    SimMark *_marks = &marks[_node * SIM_MARKS_PER_NODE];
+    for(int index = 0; index < markCount[_node] && _marks[index].start + SIM_CARRIER_DETECT_US <= simTime; index++)
+    {
+        if(_marks[index].end > _from && _marks[index].end > _marks[index].start + SIM_CARRIER_DETECT_US) return true;
+    }
+    return false;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRmedium::recordCollision(int _node, int64_t _time)
+{
+    if(_node >= 0 && _node < nodeCount) lastCollision[_node] = _time;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+bool ESP32_IRmedium::collisionSince(int _node, int64_t _time)
+{
+    if(_node < 0 || _node >= nodeCount) return false;
+    return lastCollision[_node] > _time;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRmedium::transmitSymbols(int _fromNode, const uint8_t *_symbols, int _symbolCount, int64_t _startTime)
+{
+    int _numItems = ESP32_IRtxBase::expandSymbols(_symbols, _symbolCount, txScratch, ARRAY_SIZE * 2);
+    transmitItems(_fromNode, txScratch, _numItems, _startTime);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//Lays each packet's marks onto every receiver's timeline. Loss is decided per packet, per link.
+void ESP32_IRmedium::transmitItems(int _fromNode, const rmt_item32_t *_items, int _numItems, int64_t _startTime)
+{
+    int     _packetStart    = 0;
+    int64_t _packetTime     = _startTime;
+    int64_t _time           = _startTime;
+
+    for(int index = 0; index <= _numItems; index++)
+    {
+        bool _endOfFrame    = (index == _numItems) || (_items[index].duration0 == 0);
+        bool _gap           = !_endOfFrame && (_items[index].level0 == 0);
+
+        if(!_endOfFrame && !_gap)
+        {
+            _time += _items[index].duration0 + _items[index].duration1;
+            continue;
+        }
+
+        //One whole packet is _items[_packetStart..index), starting at _packetTime
+        if(index > _packetStart)
+        {
+            packetsSent++;
+            for(int _toNode = 0; _toNode < nodeCount; _toNode++)
+            {
+                SimLink &_link = links[_fromNode * nodeCount + _toNode];
+                if(_link.lossPerMille >= 1000 || (random() % 1000) < _link.lossPerMille)
+                {
+                    if(_toNode != _fromNode)    packetsLost++;
+                    continue;
+                }
+                int64_t _markTime = _packetTime + _link.delayUs;
+                for(int _item = _packetStart; _item < index; _item++)
+                {
+                    addMark(_toNode, _fromNode, _markTime, _markTime + _items[_item].duration0);
+                    _markTime += _items[_item].duration0 + _items[_item].duration1;
+                }
+            }
+        }
+        if(_endOfFrame) break;
+
+        _time          += _items[index].duration0 + _items[index].duration1;
+        _packetStart    = index + 1;
+        _packetTime     = _time;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRmedium::addMark(int _node, int _fromNode, int64_t _start, int64_t _end)
+{
+    SimMark *_marks = &marks[_node * SIM_MARKS_PER_NODE];
+    int     &_count = markCount[_node];
+    if(_count >= SIM_MARKS_PER_NODE)    return;     //receiver swamped, the mark is lost
+
+    //Keep the timeline in start order - new marks nearly always go on the end.
+    int index = _count;
+    while(index > 0 && _marks[index - 1].start > _start)
+    {
+        _marks[index] = _marks[index - 1];
+        index--;
+    }
+    _marks[index].start     = _start;
+    _marks[index].end       = _end;
+    _marks[index].fromNode  = _fromNode;
+    _count++;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//Hands out the next burst this receiver's RMT would have finished by now - the marks up to the
+//first gap of RX_IDLE_US, with overlapping marks merged, as rmt_item32_t.
+int ESP32_IRmedium::receive(int _node, rmt_item32_t **_items, int64_t *_lastEdgeTime)
+{
+    SimMark        *_marks  = &marks[_node * SIM_MARKS_PER_NODE];
+    int             _count  = markCount[_node];
+    rmt_item32_t   *_burst  = &rxBurst[_node * SIM_MAX_BURST_ITEMS];
+
+    if(_count == 0 || _marks[0].start > simTime)    return 0;
+
+    int64_t _markStart  = _marks[0].start;
+    int64_t _markEnd    = _marks[0].end;
+    int8_t  _fromNode   = _marks[0].fromNode;
+    bool    _collided   = false;
+    int     _numItems   = 0;
+    int     _used       = 1;
+
+    while(true)
+    {
+        if(_used < _count && _marks[_used].start <= _markEnd)
+        {
+            //Overlapping marks run together
+            if(_marks[_used].fromNode != _fromNode) _collided = true;
+            if(_marks[_used].end > _markEnd)        _markEnd = _marks[_used].end;
+            _used++;
+            continue;
+        }
+
+        bool    _lastMark   = (_used >= _count) || (_marks[_used].start - _markEnd >= RX_IDLE_US);
+        int64_t _space      = _lastMark ? 0 : _marks[_used].start - _markEnd;
+
+        if(_lastMark && _markEnd + RX_IDLE_US > simTime)    return 0;     //still receiving
+
+        if(_numItems < SIM_MAX_BURST_ITEMS)
+        {
+            int64_t _mark = _markEnd - _markStart;
+            _burst[_numItems].duration0 = (_mark  > 32767) ? 32767 : _mark;
+            _burst[_numItems].level0    = 0;                //IR receivers are active low
+            _burst[_numItems].duration1 = (_space > 32767) ? 32767 : _space;
+            _burst[_numItems].level1    = 1;
+            _numItems++;
+        }
+        if(_lastMark) break;
+
+        if(_marks[_used].fromNode != _fromNode) _collided = true;
+        _markStart  = _marks[_used].start;
+        _markEnd    = _marks[_used].end;
+        _used++;
+    }
+
+    memmove(_marks, &_marks[_used], (_count - _used) * sizeof(SimMark));
+    markCount[_node] = _count - _used;
+
+    burstsDelivered++;
+    if(_collided)   collisions++;
+    *_items = _burst;
+    if(_lastEdgeTime != NULL)   *_lastEdgeTime = _markEnd;
+    return _numItems;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+uint32_t ESP32_IRmedium::readPacketsSent()      { return packetsSent; }
+uint32_t ESP32_IRmedium::readPacketsLost()      { return packetsLost; }
+uint32_t ESP32_IRmedium::readBurstsDelivered()  { return burstsDelivered; }
+uint32_t ESP32_IRmedium::readCollisions()       { return collisions; }
+
+//////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////
+//////////////////////////////////////////////////////////////////////////////////////////
+
+ESP32_IRarena::ESP32_IRarena(int _taggers, float _lossRate, uint32_t _delayUs, uint32_t _seed)
+    : irMedium(clampTaggers(_taggers) + 1, _seed)
+{
+    nodeCount           = clampTaggers(_taggers) + 1;
+    tx                  = new ESP32_IRtx<>[nodeCount];
+    rx                  = new ESP32_IRrx<>[nodeCount];
+    nodes               = new ArenaNode[nodeCount];
+    pollOrder           = new int[nodeCount];
+    gameID              = 0x55;
+    nextAnnounce        = 0;
+    nextAssignRetry     = 0;
+    retrySlot           = -1;
+    hostingComplete     = -1;
+    messagesDelivered   = 0;
+    burstsReceived      = 0;
+
+    irMedium.setAllLinks(_lossRate, _delayUs);
+
+    for(int index = 0; index < nodeCount; index++)
+    {
+        tx[index].attachMedium(&irMedium, index);
+        tx[index].setListenBeforeTalk(true, ARENA_LBT_MAX_WAIT_MS);
+        rx[index].attachMedium(&irMedium, index);
+
+        nodes[index].taggerID       = index;
+        nodes[index].joined         = false;
+        nodes[index].nextBeacon     = 0;
+        nodes[index].nextTag        = 0;
+        nodes[index].joinAt         = 0;
+        nodes[index].assignedAt     = 0;
+        nodes[index].teamNumber     = 0;
+        nodes[index].playerNumber   = 0;
+        nodes[index].packetCount    = 0;
+        pollOrder[index]            = index;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//More taggers than the roster holds could never all be hosted.
+int ESP32_IRarena::clampTaggers(int _taggers)
+{
+    if(_taggers > MAX_ARENA_TAGGERS)    _taggers = MAX_ARENA_TAGGERS;
+    if(_taggers + 1 > MAX_SIM_NODES)    _taggers = MAX_SIM_NODES - 1;
+    if(_taggers < 0)                    _taggers = 0;
+    return _taggers;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+ESP32_IRarena::~ESP32_IRarena()
+{
+    delete[] tx;
+    delete[] rx;
+    delete[] nodes;
+    delete[] pollOrder;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+ESP32_IRmedium &ESP32_IRarena::medium()
+{
+    return irMedium;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+ArenaReport ESP32_IRarena::run(float _seconds, uint32_t _stepUs)
+{
+    int64_t _startTime  = irMedium.now();
+    int64_t _endTime    = _startTime + (int64_t)(_seconds * 1000000);
+
+    while(irMedium.now() < _endTime)
+    {
+        irMedium.advance(_stepUs);
+        shufflePollOrder();
+
+        for(int index = 0; index < nodeCount; index++)
+        {
+            int _node = pollOrder[index];
+            pollNode(_node);
+            tx[_node].pollListenBeforeTalk();
+        }
+        for(int index = 0; index < nodeCount; index++)
+        {
+            int _node = pollOrder[index];
+            if(_node == 0)  runHost();
+            else            runTagger(_node);
+        }
+    }
+
+    ArenaReport _report;
+    _report.players                 = nodeCount - 1;
+    _report.simSeconds              = (irMedium.now() - _startTime) / 1000000.0;
+    _report.messagesDelivered       = messagesDelivered;
+    _report.messagesPerSecond       = messagesDelivered / _report.simSeconds;
+    _report.hostingCompleteSeconds  = (hostingComplete < 0) ? -1 : hostingComplete / 1000000.0;
+    _report.decodeYield             = burstsReceived ? (float)messagesDelivered / burstsReceived : 0;
+    _report.collisionsInAir         = irMedium.readCollisions();
+    _report.collisionsDecoded       = 0;
+    for(int index = 0; index < nodeCount; index++)  _report.collisionsDecoded += rx[index].readCollisionCount();
+
+    if(DEBUG)
+    {
+        Serial.print("ESP32_IRarena::run() - players = ");  Serial.print(_report.players);
+        Serial.print(", msg/s = ");                         Serial.print(_report.messagesPerSecond);
+        Serial.print(", hosted in ");                       Serial.print(_report.hostingCompleteSeconds);
+        Serial.print("s, yield = ");                        Serial.println(_report.decodeYield);
+    }
+    return _report;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//Fisher-Yates, from the medium's random numbers so a seed repeats.
+void ESP32_IRarena::shufflePollOrder()
+{
+    for(int index = nodeCount - 1; index > 0; index--)
+    {
+        int _swap           = irMedium.random() % (index + 1);
+        int _node           = pollOrder[index];
+        pollOrder[index]    = pollOrder[_swap];
+        pollOrder[_swap]    = _node;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRarena::pollNode(int _node)
+{
+    ArenaNode &_state = nodes[_node];
+
+    while(true)
+    {
+        ESP32_IRrxItem _rxItem = rx[_node].receiveItem(0);
+        if(!_rxItem)    break;
+
+        burstsReceived++;
+        if(!rx[_node].decodeIR(_rxItem))    continue;
+        messagesDelivered++;
+
+        char        _type = rx[_node].readMessageType();
+        uint16_t    _data = rx[_node].readRawDataPacket();
+
+        if(_type == 'P')    _state.packetCount = 0;
+        if(_type != 'P' && _type != 'D' && _type != 'C')    continue;      //tags and beacons need no reply
+        if(_node == 0 && nextAnnounce < irMedium.now() + ARENA_HOST_HOLDOFF) nextAnnounce = irMedium.now() + ARENA_HOST_HOLDOFF;
+        if(_type != 'P' && _state.packetCount == 0)         continue;      //missed the start of the message
+        if(_state.packetCount >= MAX_FRAME_PACKETS)         continue;
+
+        _state.packetType[_state.packetCount]   = _type;
+        _state.packet[_state.packetCount]       = _data;
+        _state.packetCount++;
+
+        if(_type == 'C')
+        {
+            uint16_t _sum = 0;
+            for(int index = 0; index < _state.packetCount - 1; index++) _sum += _state.packet[index];
+            if((_sum & 0xFF) == (_data & 0xFF)) onMessage(_node);
+            _state.packetCount = 0;
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRarena::onMessage(int _node)
+{
+    ArenaNode  &_state      = nodes[_node];
+    uint16_t   *_packet     = _state.packet;
+    int64_t     _now        = irMedium.now();
+
+    if(_node == 0)
+    {
+        //Host: request to join (P16 gameID taggerID team), ack (P17 gameID taggerID)
+        if(_packet[0] == 16 && _state.packetCount >= 4 && _packet[1] == gameID)
+        {
+            tx[0].assignPlayer(gameID, roster, _packet[2], _packet[3]);
+            nextAssignRetry = _now + ARENA_ASSIGN_RETRY;
+        }
+        else if(_packet[0] == 17 && _state.packetCount >= 3 && _packet[1] == gameID)
+        {
+            uint8_t _tagger = _packet[2];
+            int     _slot   = roster.findTagger(_tagger);
+            if(_slot < 0 || roster.readSlot(_slot).state == SLOT_JOINED)   return;
+            roster.setState(_tagger, SLOT_JOINED);
+            if(_tagger < nodeCount) nodes[_tagger].joined = true;
+            if(roster.readStateCount(SLOT_JOINED) == nodeCount - 1) hostingComplete = _now;
+        }
+        return;
+    }
+
+    //Tagger: announce -> request to join a little later, assign -> ack. Once it has acked, a tagger is
+    //in the game and ignores announces - if the ack was lost, the host sends the assign again.
+    if(_packet[0] == ARENA_GAME_TYPE && _packet[1] == gameID)
+    {
+        if(_state.assignedAt == 0 && _state.joinAt == 0)    _state.joinAt = _now + 1 + irMedium.random() % ARENA_JOIN_DELAY_MAX;
+    }
+    else if(_packet[0] == 1 && _state.packetCount >= 4 && _packet[1] == gameID && _packet[2] == _state.taggerID)
+    {
+        ESP32_IRroster::decodeTeamAndPlayer(_packet[3], true, _state.teamNumber, _state.playerNumber);
+        tx[_node].taggerAckPlayerAssign(gameID, _state.taggerID);
+        _state.assignedAt   = _now;
+        _state.joinAt       = 0;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//Host keeps announcing until everyone is in, and sends assigns that weren't acked again, one at a
+//time. Neither is sent over a frame still held for a clear channel, which it would replace.
+void ESP32_IRarena::runHost()
+{
+    int64_t _now = irMedium.now();
+
+    if(hostingComplete >= 0 || tx[0].isListenBeforeTalkPending())  return;
+
+    if(_now >= nextAnnounce)
+    {
+        tx[0].hostPlayerToGame(0, 0, ARENA_GAME_TYPE, gameID, 10, 25, 99, 15, 10, 0, 0);
+        nextAnnounce = _now + ARENA_ANNOUNCE_INTERVAL;
+        return;
+    }
+
+    if(_now < nextAssignRetry || roster.readStateCount(SLOT_ASSIGNED) == 0) return;
+    for(int _step = 1; _step <= MAX_ROSTER_PLAYERS; _step++)
+    {
+        int _slot = (retrySlot + _step) % MAX_ROSTER_PLAYERS;
+        const RosterSlot &_entry = roster.readSlot(_slot);
+        if(_entry.state != SLOT_ASSIGNED)   continue;
+
+        tx[0].assignPlayer(gameID, roster, _entry.taggerID, 0);
+        retrySlot       = _slot;
+        nextAssignRetry = _now + ARENA_ASSIGN_RETRY;
+        break;
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void ESP32_IRarena::runTagger(int _node)
+{
+    ArenaNode  &_state  = nodes[_node];
+    int64_t     _now    = irMedium.now();
+
+    if(_state.joinAt != 0 && _now >= _state.joinAt)
+    {
+        tx[_node].taggerRequestToJoin(gameID, _state.taggerID, 0);
+        _state.joinAt = 0;
+    }
+
+    //The game starts once the host has everyone - then beacon and shoot.
+    if(hostingComplete < 0) return;
+
+    if(_now >= _state.nextBeacon)
+    {
+        tx[_node].sendBeacon(false, _state.teamNumber, 0);
+        _state.nextBeacon = _now + ARENA_BEACON_INTERVAL;
+    }
+    if(_now >= _state.nextTag)
+    {
+        tx[_node].sendTag(_state.teamNumber, _state.playerNumber, 0);
+        _state.nextTag = _now + ARENA_TAG_INTERVAL / 2 + irMedium.random() % ARENA_TAG_INTERVAL;
+    }
+}
@@ -0,0 +1,160 @@
+ /* Copyright (c) 2018 Richie Mickan. All Rights Reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>. *
+ */
+
+/* A virtual IR medium and a multi-tagger arena built on it.
+ * Tx/Rx instances attached to an ESP32_IRmedium send and receive through software instead of the RMT,
+ * on a virtual clock, so a 24 player game can be run far faster than real time to load test
+ * hosting and decoding. Each link has its own loss rate and delay, and bursts that overlap at a
+ * receiver are merged the way they would be in the air (so they decode as collisions).
+ * A Tx instance's listen-before-talk senses carrier, and sees collisions, at its own node.
+ */
+
+#ifndef ESP32_IR_SIM_H_
+#define ESP32_IR_SIM_H_
+
+#include "ESP32_IR_LTTO.h"
+#include "ESP32_IR_Roster.h"
+
+#define MAX_SIM_NODES           32
+#define SIM_MARKS_PER_NODE      512     //marks in flight towards each receiver
+#define SIM_MAX_BURST_ITEMS     64
+#define SIM_CARRIER_DETECT_US   400     //an IR receiver's output lags the start of a mark by this much
+#define MAX_ARENA_TAGGERS       MAX_ROSTER_PLAYERS
+
+struct SimMark
+{
+    int64_t     start;
+    int64_t     end;
+    int8_t      fromNode;
+};
+
+struct SimLink
+{
+    uint16_t    lossPerMille;
+    uint32_t    delayUs;
+};
+
+class ESP32_IRmedium {
+  public:
+    ESP32_IRmedium(int _nodeCount, uint32_t _seed = 1);
+    ~ESP32_IRmedium();
+
+    void        setLink(int _fromNode, int _toNode, float _lossRate, uint32_t _delayUs);
+    void        setAllLinks(float _lossRate, uint32_t _delayUs);
+
+    int64_t     now();
+    void        advance(uint32_t _us);
+
+    void        transmitSymbols(int _fromNode, const uint8_t *_symbols, int _symbolCount, int64_t _startTime);
+    void        transmitItems(int _fromNode, const rmt_item32_t *_items, int _numItems, int64_t _startTime);
+    int         receive(int _node, rmt_item32_t **_items, int64_t *_lastEdgeTime = NULL);
+
+    uint32_t    random();
+
+    //Listen-before-talk for the attached Tx instances, per node
+    bool        carrierSensed(int _node);                       //a mark came out of the node's receiver during the last step
+    void        recordCollision(int _node, int64_t _time);      //the node's receiver decoded a collision
+    bool        collisionSince(int _node, int64_t _time);
+
+    uint32_t    readPacketsSent();
+    uint32_t    readPacketsLost();
+    uint32_t    readBurstsDelivered();
+    uint32_t    readCollisions();
+
+  private:
+    int             nodeCount;
+    int64_t         simTime;
+    uint32_t        lastStepUs;
+    uint32_t        randomState;
+    SimLink        *links;                  //[from * nodeCount + to]
+    SimMark        *marks;                  //[node * SIM_MARKS_PER_NODE + n], kept in start order
+    int            *markCount;
+    int64_t        *lastCollision;          //[node]
+    rmt_item32_t   *rxBurst;                //[node * SIM_MAX_BURST_ITEMS + n], last burst handed out
+    rmt_item32_t    txScratch[ARRAY_SIZE * 2];
+
+    uint32_t        packetsSent;
+    uint32_t        packetsLost;
+    uint32_t        burstsDelivered;
+    uint32_t        collisions;
+
+    void    addMark(int _node, int _fromNode, int64_t _start, int64_t _end);
+};
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+struct ArenaReport
+{
+    int         players;
+    float       simSeconds;
+    uint32_t    messagesDelivered;          //valid packets decoded, all nodes
+    float       messagesPerSecond;
+    float       hostingCompleteSeconds;     //-1 if not every tagger joined
+    float       decodeYield;                //valid packets / bursts received
+    uint32_t    collisionsInAir;            //bursts that overlapped at a receiver
+    uint32_t    collisionsDecoded;          //bursts the decoders classed as collisions
+};
+
+struct ArenaNode
+{
+    uint8_t     taggerID;
+    bool        joined;                     //host has our ack
+    int64_t     nextBeacon;
+    int64_t     nextTag;
+    int64_t     joinAt;                     //0 = no join request pending
+    int64_t     assignedAt;                 //when we acked our assignment, 0 = not yet
+    uint8_t     teamNumber;                 //as assigned by the host
+    uint8_t     playerNumber;
+    uint16_t    packet[MAX_FRAME_PACKETS];  //message being reassembled
+    char        packetType[MAX_FRAME_PACKETS];
+    int         packetCount;
+};
+
+//Node 0 hosts, nodes 1..N are taggers that join the game, then beacon and tag each other.
+//There are at most MAX_ARENA_TAGGERS taggers, as many as the host's roster holds. Each step polls
+//the nodes in a new random order, so no node wins every tie.
+class ESP32_IRarena {
+  public:
+    ESP32_IRarena(int _taggers, float _lossRate = 0, uint32_t _delayUs = 0, uint32_t _seed = 1);
+    ~ESP32_IRarena();
+
+    ESP32_IRmedium  &medium();
+    ArenaReport     run(float _seconds, uint32_t _stepUs = 1000);
+
+  private:
+    int                 nodeCount;
+    ESP32_IRmedium      irMedium;
+    ESP32_IRtx<>       *tx;
+    ESP32_IRrx<>       *rx;
+    ArenaNode          *nodes;
+    int                *pollOrder;              //node indexes, shuffled every step
+    uint8_t             gameID;
+    ESP32_IRroster      roster;                 //host's
+    int64_t             nextAnnounce;
+    int64_t             nextAssignRetry;
+    int                 retrySlot;              //roster slot the host last re-sent an assign for
+    int64_t             hostingComplete;
+    uint32_t            messagesDelivered;
+    uint32_t            burstsReceived;
+
+    static int  clampTaggers(int _taggers);
+    void    shufflePollOrder();
+    void    pollNode(int _node);
+    void    onMessage(int _node);
+    void    runHost();
+    void    runTagger(int _node);
+};
+
+#endif /* ESP32_IR_SIM_H_ */
@@ -0,0 +1,65 @@
+//Host shim - just enough of Arduino for the library to build and run in the tests. String works
+//as Arduino's does, for sendLttoIR(String).
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string>
+#include <utility>
+
+typedef uint8_t byte;
+
+class String {
+  public:
+    String() {}
+    String(const char *_text) : text(_text) {}
+    String(int _value) : text(std::to_string(_value)) {}
+    void        trim()
+    {
+        size_t _first = text.find_first_not_of(" \t\r\n");
+        if(_first == std::string::npos) text.clear();
+        else                            text = text.substr(_first, text.find_last_not_of(" \t\r\n") - _first + 1);
+    }
+    unsigned    length() const                          { return text.size(); }
+    char        charAt(unsigned _index) const           { return _index < text.size() ? text[_index] : 0; }
+    void        remove(unsigned _index, unsigned _count)
+    {
+        if(_index < text.size())    text.erase(_index, _count);
+    }
+    int         indexOf(const char *_what) const
+    {
+        size_t _at = text.find(_what);
+        return _at == std::string::npos ? -1 : (int)_at;
+    }
+    String      substring(unsigned _left, unsigned _right) const
+    {
+        if(_left > _right)  std::swap(_left, _right);
+        if(_left >= text.size())    return String();
+        return String(text.substr(_left, _right - _left).c_str());
+    }
+    long        toInt() const                           { return atol(text.c_str()); }
+    String      operator+(const String &_other) const   { return String((text + _other.text).c_str()); }
+
+  private:
+    std::string text;
+};
+
+struct HardwareSerial {
+    template <class T> void print(T) {}
+    template <class T> void print(T, int) {}
+    template <class T> void println(T) {}
+    template <class T> void println(T, int) {}
+    void println() {}
+};
+extern HardwareSerial Serial;
+
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+#define CHANGE              0x03
+
+unsigned long   millis();
+unsigned long   micros();
+void            attachInterruptArg(uint8_t _pin, void (*_isr)(void*), void *_arg, int _mode);
+void            detachInterrupt(uint8_t _pin);
+
+#include "esp32-hal.h"
@@ -0,0 +1,24 @@
+//Host shim
+#pragma once
+#include "esp_err.h"
+
+typedef enum { GPIO_NUM_0 = 0, GPIO_NUM_MAX = 40 } gpio_num_t;
+typedef enum { GPIO_INTR_DISABLE, GPIO_INTR_ANYEDGE } gpio_int_type_t;
+typedef enum { GPIO_MODE_INPUT } gpio_mode_t;
+typedef void (*gpio_isr_t)(void *);
+
+#define ESP_INTR_FLAG_IRAM  1
+#define IRAM_ATTR
+#define DRAM_ATTR
+
+extern "C" {
+esp_err_t   gpio_pullup_en(gpio_num_t);
+int         gpio_get_level(gpio_num_t);
+esp_err_t   gpio_set_intr_type(gpio_num_t, gpio_int_type_t);
+esp_err_t   gpio_install_isr_service(int);
+esp_err_t   gpio_isr_handler_add(gpio_num_t, gpio_isr_t, void *);
+esp_err_t   gpio_isr_handler_remove(gpio_num_t);
+esp_err_t   gpio_set_direction(gpio_num_t, gpio_mode_t);
+esp_err_t   gpio_intr_enable(gpio_num_t);
+esp_err_t   gpio_intr_disable(gpio_num_t);
+}
@@ -0,0 +1,2 @@
+//Host shim
+#pragma once
@@ -0,0 +1,82 @@
+//Host shim - see shim.cpp for what rmt_write_sample() does.
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "driver/gpio.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/ringbuf.h"
+
+typedef struct
+{
+    union
+    {
+        struct
+        {
+            uint32_t duration0 :15;
+            uint32_t level0    :1;
+            uint32_t duration1 :15;
+            uint32_t level1    :1;
+        };
+        uint32_t val;
+    };
+} rmt_item32_t;
+
+typedef enum { RMT_CHANNEL_0 = 0, RMT_CHANNEL_MAX = 8 } rmt_channel_t;
+typedef enum { RMT_MODE_TX = 0, RMT_MODE_RX } rmt_mode_t;
+typedef enum { RMT_CARRIER_LEVEL_LOW, RMT_CARRIER_LEVEL_HIGH } rmt_carrier_level_t;
+typedef enum { RMT_IDLE_LEVEL_LOW, RMT_IDLE_LEVEL_HIGH } rmt_idle_level_t;
+
+typedef struct
+{
+    uint32_t            carrier_freq_hz;
+    rmt_carrier_level_t carrier_level;
+    rmt_idle_level_t    idle_level;
+    uint8_t             carrier_duty_percent;
+    uint32_t            loop_count;
+    bool                carrier_en;
+    bool                loop_en;
+    bool                idle_output_en;
+} rmt_tx_config_t;
+
+typedef struct
+{
+    uint16_t            idle_threshold;
+    uint8_t             filter_ticks_thresh;
+    bool                filter_en;
+    bool                rm_carrier;
+} rmt_rx_config_t;
+
+typedef struct
+{
+    rmt_mode_t          rmt_mode;
+    rmt_channel_t       channel;
+    gpio_num_t          gpio_num;
+    uint8_t             clk_div;
+    uint8_t             mem_block_num;
+    uint32_t            flags;
+    union
+    {
+        rmt_tx_config_t tx_config;
+        rmt_rx_config_t rx_config;
+    };
+} rmt_config_t;
+
+typedef void (*sample_to_rmt_t)(const void *src, rmt_item32_t *dest, size_t src_size, size_t wanted_num,
+                                size_t *translated_size, size_t *item_num);
+typedef void (*rmt_tx_end_fn_t)(rmt_channel_t channel, void *arg);
+typedef struct { rmt_tx_end_fn_t function; void *arg; } rmt_tx_end_callback_t;
+
+extern "C" {
+esp_err_t   rmt_config(const rmt_config_t *);
+esp_err_t   rmt_driver_install(rmt_channel_t, size_t, int);
+esp_err_t   rmt_driver_uninstall(rmt_channel_t);
+esp_err_t   rmt_get_ringbuf_handle(rmt_channel_t, RingbufHandle_t *);
+esp_err_t   rmt_rx_start(rmt_channel_t, bool);
+esp_err_t   rmt_rx_stop(rmt_channel_t);
+esp_err_t   rmt_write_items(rmt_channel_t, const rmt_item32_t *, int, bool);
+esp_err_t   rmt_wait_tx_done(rmt_channel_t, TickType_t);
+esp_err_t   rmt_translator_init(rmt_channel_t, sample_to_rmt_t);
+esp_err_t   rmt_write_sample(rmt_channel_t, const uint8_t *, size_t, bool);
+rmt_tx_end_callback_t rmt_register_tx_end_callback(rmt_tx_end_fn_t, void *);
+}
@@ -0,0 +1,10 @@
+//Host shim
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "esp_cpu.h"
+#include "driver/gpio.h"
@@ -0,0 +1,4 @@
+//Host shim
+#pragma once
+#include <stdint.h>
+extern "C" uint32_t esp_random(void);
@@ -0,0 +1,27 @@
+//Host shim - tasks are threads (see shim.cpp), so a critical section is a spin lock.
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+typedef uint32_t    TickType_t;
+typedef int         BaseType_t;
+typedef unsigned    UBaseType_t;
+typedef struct { int locked; } portMUX_TYPE;
+
+#define pdTRUE                      1
+#define pdFALSE                     0
+#define pdPASS                      1
+#define portMAX_DELAY               0xFFFFFFFF
+#define portTICK_PERIOD_MS          1
+#define pdMS_TO_TICKS(x)            (x)
+#define tskNO_AFFINITY              0x7FFFFFFF
+#define portMUX_INITIALIZER_UNLOCKED {0}
+#define portENTER_CRITICAL(m)       shimEnterCritical(m)
+#define portEXIT_CRITICAL(m)        shimExitCritical(m)
+#define portENTER_CRITICAL_ISR(m)   shimEnterCritical(m)
+#define portEXIT_CRITICAL_ISR(m)    shimExitCritical(m)
+
+extern "C" {
+void        shimEnterCritical(portMUX_TYPE *);
+void        shimExitCritical(portMUX_TYPE *);
+}
@@ -0,0 +1,17 @@
+//Host shim - the RMT Rx ring buffers hold what a test passes to shimReceive(), see shim.cpp.
+#pragma once
+#include "freertos/FreeRTOS.h"
+
+typedef void *RingbufHandle_t;
+#define RINGBUF_TYPE_NOSPLIT 0
+
+extern "C" {
+RingbufHandle_t xRingbufferCreate(size_t, int);
+void           *xRingbufferReceive(RingbufHandle_t, size_t *, TickType_t);
+void            vRingbufferReturnItem(RingbufHandle_t, void *);
+size_t          xRingbufferGetCurFreeSize(RingbufHandle_t);
+size_t          xRingbufferGetMaxItemSize(RingbufHandle_t);
+void            vRingbufferGetInfo(RingbufHandle_t, UBaseType_t *, UBaseType_t *, UBaseType_t *, UBaseType_t *, UBaseType_t *, UBaseType_t *);
+BaseType_t      xRingbufferSend(RingbufHandle_t, const void *, size_t, TickType_t);
+BaseType_t      xRingbufferSendFromISR(RingbufHandle_t, const void *, size_t, BaseType_t *);
+}
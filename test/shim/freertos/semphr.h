@@ -0,0 +1,12 @@
+//Host shim
+#pragma once
+#include "freertos/FreeRTOS.h"
+
+typedef void *SemaphoreHandle_t;
+typedef struct { int taken; } StaticSemaphore_t;
+
+extern "C" {
+SemaphoreHandle_t   xSemaphoreCreateMutexStatic(StaticSemaphore_t *);
+BaseType_t          xSemaphoreTake(SemaphoreHandle_t, TickType_t);
+BaseType_t          xSemaphoreGive(SemaphoreHandle_t);
+}
@@ -0,0 +1,417 @@
+ /* Copyright (c) 2018 Richie Mickan. All Rights Reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>. *
+ */
+
+/* Host shim - the ESP-IDF and Arduino calls the library makes, for the tests in this directory.
+ * The clock only moves when a test sets shimNow. CPU cycles are real nanoseconds, so costs can be compared. rmt_write_sample() expands the frame the way the
+ * RMT driver does, through the translator registered with rmt_translator_init(), and keeps the items
+ * in shimItems.
+ * Tasks are threads, with FreeRTOS's notifications, mutexes and critical sections, and a tick is a
+ * real millisecond. A task can only be deleted once it has suspended itself (as the pipeline's do).
+ * Each Rx channel's ring buffer holds what the test passes to shimReceive(), and drops a burst that
+ * doesn't fit, as the RMT driver does. shimEdge() toggles a pin (idle high, as an IR receiver's output)
+ * and runs the interrupt attached to it, and
+ * shimTimers() the callback of every running esp_timer - timers never come due by themselves.
+ */
+
+#include "Arduino.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "driver/rmt.h"
+#include "shim.h"
+#include <pthread.h>
+#include <sched.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#define SHIM_RMT_BLOCK  64      //items the driver asks the translator for at a time
+#define SHIM_TIMERS     8
+
+struct ShimTask
+{
+    TaskFunction_t          code;
+    void                   *arg;
+    std::mutex              lock;
+    std::condition_variable wake;
+    uint32_t                notified    = 0;
+    bool                    deleted     = false;
+};
+
+struct ShimTimer
+{
+    esp_timer_create_args_t args;
+    bool                    created     = false;
+    bool                    running     = false;
+    bool                    once        = false;
+};
+
+struct ShimRing
+{
+    std::mutex              lock;
+    std::condition_variable ready;
+    std::deque<uint8_t*>    bursts;         //each a size_t byte count, then the items
+    size_t                  size        = 0;
+    size_t                  used        = 0;    //queued, or handed out and not yet returned
+};
+
+HardwareSerial              Serial;
+int64_t                     shimNow     = 0;
+std::vector<rmt_item32_t>   shimItems;
+static sample_to_rmt_t      translator  = NULL;
+static ShimTimer            timers[SHIM_TIMERS];
+static ShimRing             rings[RMT_CHANNEL_MAX];
+static void               (*pinIsr[GPIO_NUM_MAX])(void*);
+static void                *pinIsrArg[GPIO_NUM_MAX];
+static bool                 pinMark[GPIO_NUM_MAX];      //IR present - an IR receiver's output is low
+static thread_local ShimTask *currentTask = NULL;
+
+unsigned long   millis()                                            { return shimNow / 1000; }
+unsigned long   micros()                                            { return shimNow; }
+
+void attachInterruptArg(uint8_t _pin, void (*_isr)(void*), void *_arg, int)
+{
+    pinIsr[_pin]    = _isr;
+    pinIsrArg[_pin] = _arg;
+}
+
+void detachInterrupt(uint8_t _pin)
+{
+    pinIsr[_pin]    = NULL;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void shimEdge(int _pin, int64_t _time)
+{
+    shimNow         = _time;
+    pinMark[_pin]   = !pinMark[_pin];
+    if(pinIsr[_pin] != NULL)    pinIsr[_pin](pinIsrArg[_pin]);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+void shimTimers()
+{
+    for(int index = 0; index < SHIM_TIMERS; index++)
+    {
+        ShimTimer &_timer = timers[index];
+        if(!_timer.running) continue;
+        if(_timer.once) _timer.running = false;
+        _timer.args.callback(_timer.args.arg);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//How long a wait of _ticks may take, a tick being 1mS
+static bool waitTicks(std::condition_variable &_cv, std::unique_lock<std::mutex> &_lock, TickType_t _ticks,
+                      const std::function<bool()> &_done)
+{
+    if(_ticks == portMAX_DELAY)
+    {
+        _cv.wait(_lock, _done);
+        return true;
+    }
+    return _cv.wait_for(_lock, std::chrono::milliseconds(_ticks), _done);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+bool shimReceive(int _channel, const rmt_item32_t *_items, int _count)
+{
+    ShimRing   &_ring   = rings[_channel];
+    size_t      _bytes  = _count * sizeof(rmt_item32_t);
+    std::lock_guard<std::mutex> _guard(_ring.lock);
+    if(_ring.size == 0 || _ring.used + _bytes > _ring.size)    return false;
+
+    uint8_t *_burst = new uint8_t[sizeof(size_t) + _bytes];
+    memcpy(_burst, &_bytes, sizeof(size_t));
+    memcpy(_burst + sizeof(size_t), _items, _bytes);
+    _ring.bursts.push_back(_burst);
+    _ring.used += _bytes;
+    _ring.ready.notify_all();
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+size_t shimRxBacklog(int _channel)
+{
+    std::lock_guard<std::mutex> _guard(rings[_channel].lock);
+    return rings[_channel].used;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+static void *runTask(void *_arg)
+{
+    currentTask = (ShimTask*)_arg;
+    currentTask->code(currentTask->arg);
+    return NULL;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//Waits until the task is deleted, then ends its thread.
+static void endTask(ShimTask *_task)
+{
+    {
+        std::unique_lock<std::mutex> _guard(_task->lock);
+        _task->wake.wait(_guard, [_task]{ return _task->deleted; });
+    }
+    delete _task;
+    pthread_exit(NULL);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+extern "C" {
+
+esp_err_t   rmt_config(const rmt_config_t *)                        { return ESP_OK; }
+esp_err_t   rmt_driver_install(rmt_channel_t _channel, size_t _size, int) { rings[_channel].size = _size; return ESP_OK; }
+esp_err_t   rmt_driver_uninstall(rmt_channel_t _channel)            { rings[_channel].size = 0; return ESP_OK; }
+esp_err_t   rmt_get_ringbuf_handle(rmt_channel_t _channel, RingbufHandle_t *_handle)
+{
+    *_handle = rings[_channel].size ? &rings[_channel] : NULL;
+    return ESP_OK;
+}
+esp_err_t   rmt_rx_start(rmt_channel_t, bool)                       { return ESP_OK; }
+esp_err_t   rmt_rx_stop(rmt_channel_t)                              { return ESP_OK; }
+esp_err_t   rmt_wait_tx_done(rmt_channel_t, TickType_t)             { return ESP_OK; }
+esp_err_t   rmt_translator_init(rmt_channel_t, sample_to_rmt_t _fn) { translator = _fn; return ESP_OK; }
+
+esp_err_t rmt_write_items(rmt_channel_t, const rmt_item32_t *_items, int _count, bool)
+{
+    shimItems.assign(_items, _items + _count);
+    return ESP_OK;
+}
+
+esp_err_t rmt_write_sample(rmt_channel_t, const uint8_t *_src, size_t _size, bool)
+{
+    shimItems.clear();
+    if(translator == NULL)  return ESP_FAIL;
+
+    rmt_item32_t    _block[SHIM_RMT_BLOCK];
+    size_t          _done = 0;
+    while(_done < _size)
+    {
+        size_t _translated = 0;
+        size_t _items      = 0;
+        translator(_src + _done, _block, _size - _done, SHIM_RMT_BLOCK, &_translated, &_items);
+        if(_translated == 0)    return ESP_FAIL;
+        shimItems.insert(shimItems.end(), _block, _block + _items);
+        _done += _translated;
+    }
+    return ESP_OK;
+}
+
+rmt_tx_end_callback_t rmt_register_tx_end_callback(rmt_tx_end_fn_t, void *)
+{
+    rmt_tx_end_callback_t _previous = { NULL, NULL };
+    return _previous;
+}
+
+esp_err_t   gpio_pullup_en(gpio_num_t)                              { return ESP_OK; }
+int         gpio_get_level(gpio_num_t _pin)                         { return pinMark[_pin] ? 0 : 1; }
+esp_err_t   gpio_set_intr_type(gpio_num_t, gpio_int_type_t)         { return ESP_OK; }
+esp_err_t   gpio_install_isr_service(int)                           { return ESP_OK; }
+esp_err_t   gpio_isr_handler_add(gpio_num_t, gpio_isr_t, void *)    { return ESP_OK; }
+esp_err_t   gpio_isr_handler_remove(gpio_num_t)                     { return ESP_OK; }
+esp_err_t   gpio_set_direction(gpio_num_t, gpio_mode_t)             { return ESP_OK; }
+esp_err_t   gpio_intr_enable(gpio_num_t)                            { return ESP_OK; }
+esp_err_t   gpio_intr_disable(gpio_num_t)                           { return ESP_OK; }
+
+void *xRingbufferReceive(RingbufHandle_t _handle, size_t *_size, TickType_t _ticks)
+{
+    ShimRing &_ring = *(ShimRing*)_handle;
+    std::unique_lock<std::mutex> _guard(_ring.lock);
+    *_size = 0;
+    if(!waitTicks(_ring.ready, _guard, _ticks, [&_ring]{ return !_ring.bursts.empty(); }))   return NULL;
+
+    uint8_t *_burst = _ring.bursts.front();
+    _ring.bursts.pop_front();
+    memcpy(_size, _burst, sizeof(size_t));
+    return _burst + sizeof(size_t);
+}
+
+void vRingbufferReturnItem(RingbufHandle_t _handle, void *_item)
+{
+    ShimRing   &_ring   = *(ShimRing*)_handle;
+    uint8_t    *_burst  = (uint8_t*)_item - sizeof(size_t);
+    size_t      _bytes;
+    memcpy(&_bytes, _burst, sizeof(size_t));
+    {
+        std::lock_guard<std::mutex> _guard(_ring.lock);
+        _ring.used -= _bytes;
+    }
+    delete[] _burst;
+}
+
+size_t xRingbufferGetCurFreeSize(RingbufHandle_t _handle)
+{
+    ShimRing &_ring = *(ShimRing*)_handle;
+    std::lock_guard<std::mutex> _guard(_ring.lock);
+    return _ring.size - _ring.used;
+}
+
+RingbufHandle_t xRingbufferCreate(size_t, int)                      { return NULL; }
+size_t          xRingbufferGetMaxItemSize(RingbufHandle_t)          { return 1000; }
+void            vRingbufferGetInfo(RingbufHandle_t, UBaseType_t *, UBaseType_t *, UBaseType_t *, UBaseType_t *, UBaseType_t *, UBaseType_t *) {}
+BaseType_t      xRingbufferSend(RingbufHandle_t, const void *, size_t, TickType_t)          { return pdTRUE; }
+BaseType_t      xRingbufferSendFromISR(RingbufHandle_t, const void *, size_t, BaseType_t *) { return pdTRUE; }
+
+//The core and priority are ignored - the OS schedules the thread.
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t _code, const char *, uint32_t, void *_arg, UBaseType_t,
+                                   TaskHandle_t *_handle, BaseType_t)
+{
+    ShimTask *_task = new ShimTask;
+    _task->code = _code;
+    _task->arg  = _arg;
+
+    pthread_t _thread;
+    if(pthread_create(&_thread, NULL, runTask, _task) != 0)
+    {
+        delete _task;
+        return pdFALSE;
+    }
+    pthread_detach(_thread);
+    if(_handle != NULL) *_handle = _task;
+    return pdPASS;
+}
+
+void vTaskDelete(TaskHandle_t _handle)
+{
+    ShimTask *_task = (_handle == NULL) ? currentTask : (ShimTask*)_handle;
+    if(_task == NULL)   return;
+    {
+        std::lock_guard<std::mutex> _guard(_task->lock);
+        _task->deleted = true;
+        _task->wake.notify_all();
+    }
+    if(_task == currentTask)    endTask(_task);
+}
+
+//Only a task suspending itself - it sleeps until vTaskDelete().
+void vTaskSuspend(TaskHandle_t _handle)
+{
+    if((_handle == NULL || _handle == currentTask) && currentTask != NULL)  endTask(currentTask);
+}
+
+void vTaskDelay(TickType_t _ticks)
+{
+    if(_ticks == 0) sched_yield();
+    else            std::this_thread::sleep_for(std::chrono::milliseconds(_ticks));
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t _clearOnExit, TickType_t _ticks)
+{
+    ShimTask *_task = currentTask;
+    if(_task == NULL)   return 0;
+
+    std::unique_lock<std::mutex> _guard(_task->lock);
+    waitTicks(_task->wake, _guard, _ticks, [_task]{ return _task->notified > 0; });
+    uint32_t _count = _task->notified;
+    if(_count > 0)  _task->notified = _clearOnExit ? 0 : _count - 1;
+    return _count;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t _handle)
+{
+    ShimTask *_task = (ShimTask*)_handle;
+    std::lock_guard<std::mutex> _guard(_task->lock);
+    _task->notified++;
+    _task->wake.notify_all();
+    return pdPASS;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t _handle, BaseType_t *)
+{
+    xTaskNotifyGive(_handle);
+}
+
+TickType_t  xTaskGetTickCount(void)                                 { return shimNow / 1000; }
+
+void shimEnterCritical(portMUX_TYPE *_mux)
+{
+    while(__atomic_exchange_n(&_mux->locked, 1, __ATOMIC_ACQUIRE))  sched_yield();
+}
+
+void shimExitCritical(portMUX_TYPE *_mux)
+{
+    __atomic_store_n(&_mux->locked, 0, __ATOMIC_RELEASE);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *_buffer)
+{
+    _buffer->taken = 0;
+    return _buffer;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t _lock, TickType_t _ticks)
+{
+    StaticSemaphore_t  *_buffer     = (StaticSemaphore_t*)_lock;
+    auto                _deadline   = std::chrono::steady_clock::now() + std::chrono::milliseconds(_ticks);
+    while(__atomic_exchange_n(&_buffer->taken, 1, __ATOMIC_ACQUIRE))
+    {
+        if(_ticks != portMAX_DELAY && std::chrono::steady_clock::now() >= _deadline)  return pdFALSE;
+        sched_yield();
+    }
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t _lock)
+{
+    __atomic_store_n(&((StaticSemaphore_t*)_lock)->taken, 0, __ATOMIC_RELEASE);
+    return pdTRUE;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *_args, esp_timer_handle_t *_timer)
+{
+    for(int index = 0; index < SHIM_TIMERS; index++)
+    {
+        if(timers[index].created)   continue;
+        timers[index].args      = *_args;
+        timers[index].created   = true;
+        timers[index].running   = false;
+        *_timer = (esp_timer_handle_t)&timers[index];
+        return ESP_OK;
+    }
+    return ESP_FAIL;
+}
+
+static esp_err_t startTimer(esp_timer_handle_t _timer, bool _once)
+{
+    ShimTimer *_shimTimer = (ShimTimer*)_timer;
+    _shimTimer->running = true;
+    _shimTimer->once    = _once;
+    return ESP_OK;
+}
+
+esp_err_t   esp_timer_start_periodic(esp_timer_handle_t _timer, uint64_t)   { return startTimer(_timer, false); }
+esp_err_t   esp_timer_start_once(esp_timer_handle_t _timer, uint64_t)       { return startTimer(_timer, true); }
+esp_err_t   esp_timer_stop(esp_timer_handle_t _timer)                       { ((ShimTimer*)_timer)->running = false; return ESP_OK; }
+esp_err_t   esp_timer_delete(esp_timer_handle_t _timer)                     { *(ShimTimer*)_timer = ShimTimer(); return ESP_OK; }
+int64_t     esp_timer_get_time(void)                                { return shimNow; }
+
+uint32_t    esp_random(void)                                        { return (uint32_t)rand(); }
+esp_cpu_cycle_count_t esp_cpu_get_cycle_count(void)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
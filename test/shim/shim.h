@@ -0,0 +1,12 @@
+//Host shim - what the tests can see of it. See shim.cpp.
+#pragma once
+#include <vector>
+#include "driver/rmt.h"
+
+extern int64_t                      shimNow;        //esp_timer_get_time(), uS
+extern std::vector<rmt_item32_t>    shimItems;      //the last frame written to the RMT
+
+bool    shimReceive(int _channel, const rmt_item32_t *_items, int _count);  //a burst into an Rx ring buffer
+size_t  shimRxBacklog(int _channel);                                        //bytes waiting in it
+void    shimEdge(int _pin, int64_t _time);                                  //sets shimNow, toggles the pin, runs its interrupt
+void    shimTimers();                                                       //runs every running esp_timer's callback, once
@@ -0,0 +1,79 @@
+ /* Copyright (c) 2018 Richie Mickan. All Rights Reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>. *
+ */
+
+/* Arena load test - runs ESP32_IRarena over a sweep of player counts and prints each report.
+ * Small games (1-8 taggers) must finish hosting for every seed. Larger ones are reported, not
+ * asserted - they are what to watch when hosting or listen-before-talk changes.
+ * An optional argument sets the packet loss, eg. test_arena 0.05
+ */
+
+#include "Arduino.h"
+#include "ESP32_IR_Sim.h"
+#include <stdio.h>
+
+#define ARENA_SECONDS       120
+#define ARENA_SEEDS         5
+#define ARENA_ASSERT_MAX    8       //up to this many taggers must always be hosted
+
+static int failures = 0;
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+static void runPlayers(int _taggers, float _lossRate)
+{
+    int     _hosted     = 0;
+    float   _worst      = 0;
+    for(int _seed = 1; _seed <= ARENA_SEEDS; _seed++)
+    {
+        ESP32_IRarena   _arena(_taggers, _lossRate, 0, _seed);
+        ArenaReport     _report = _arena.run(ARENA_SECONDS);
+
+        if(_report.hostingCompleteSeconds >= 0)
+        {
+            _hosted++;
+            if(_report.hostingCompleteSeconds > _worst) _worst = _report.hostingCompleteSeconds;
+        }
+        if(_seed == 1)
+        {
+            printf("%3d taggers  hosted in %6.2fs  %6.1f msg/s  yield %.3f  collisions %5u in air, %5u decoded",
+                   _report.players, _report.hostingCompleteSeconds, _report.messagesPerSecond,
+                   _report.decodeYield, _report.collisionsInAir, _report.collisionsDecoded);
+        }
+    }
+
+    bool _ok = _taggers > ARENA_ASSERT_MAX || _hosted == ARENA_SEEDS;
+    if(!_ok)    failures++;
+    printf("  |  %d/%d seeds hosted, worst %6.2fs%s\n", _hosted, ARENA_SEEDS, _worst, _ok ? "" : "  FAIL");
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char **argv)
+{
+    float _lossRate = (argc > 1) ? atof(argv[1]) : 0;
+
+    static const int _players[] = { 1, 2, 3, 4, 6, 8, 12, 16, 20, 24 };
+    for(unsigned int index = 0; index < sizeof(_players) / sizeof(_players[0]); index++)   runPlayers(_players[index], _lossRate);
+
+    //More taggers than the roster holds are cut down to it, rather than never finishing.
+    ESP32_IRarena   _crowd(31, _lossRate);
+    ArenaReport     _report = _crowd.run(1);
+    bool            _ok     = _report.players == MAX_ARENA_TAGGERS;
+    if(!_ok)    failures++;
+    printf("%-4s 31 taggers asked for, %d run\n", _ok ? "ok" : "FAIL", _report.players);
+
+    printf("%d failed\n", failures);
+    return failures ? 1 : 0;
+}
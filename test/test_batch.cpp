@@ -0,0 +1,206 @@
+ /* Copyright (c) 2018 Richie Mickan. All Rights Reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>. *
+ */
+
+/* Batch decoder against parseLTTO(). Clean frames of every type are checked for their type and data,
+ * then a fuzzed log - jittered frames, durations on either side of every window edge, and random
+ * bursts of 0 to 40 items - goes through decode() a batch at a time, and verify() must find no
+ * frame where the two decoders disagree.
+ *   test_batch [frames]     (default 400000)
+ */
+
+#include "Arduino.h"
+#include "ESP32_IR_Batch.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define FUZZ_FRAMES         400000
+#define FUZZ_MAX_ITEMS      40
+
+static int      failures    = 0;
+static uint32_t seed        = 0x2018;
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//xorshift32 - the same log on every run
+static uint32_t nextRandom()
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+static void setItem(rmt_item32_t &_item, uint32_t _mark, uint32_t _space)
+{
+    _item.duration0 = _mark  & 0x7FFF;
+    _item.level0    = 1;
+    _item.duration1 = _space & 0x7FFF;
+    _item.level1    = 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//A frame as the receiver sees it - the last bit has no space, the burst ended on the idle threshold.
+static int encodeFrame(rmt_item32_t *_items, unsigned int _header, uint32_t _data, int _bitCount)
+{
+    setItem(_items[0], PRE_SYNC_MARK, PRE_SYNC_SPACE);
+    setItem(_items[1], _header, MARK_SPACE);
+    for(int index = 0; index < _bitCount; index++)
+    {
+        bool _one = (_data >> (_bitCount - 1 - index)) & 1;
+        setItem(_items[2 + index], _one ? ONE_BIT : ZERO_BIT, (index < _bitCount - 1) ? MARK_SPACE : 0);
+    }
+    return _bitCount + 2;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+static void checkClean(ESP32_IRbatchDecoder &_batch)
+{
+    static const struct { unsigned int header; uint32_t data; int bits; char type; } _frames[] =
+    {
+        { TAG_PACKET_HEADER,    0x5B,   TAG_BIT_COUNT,          'T' },
+        { TAG_PACKET_HEADER,    0x02,   PACKET_BIT_COUNT,       'P' },
+        { TAG_PACKET_HEADER,    0x1A5,  PACKET_BIT_COUNT,       'C' },
+        { TAG_PACKET_HEADER,    0xC3,   DATA_BIT_COUNT,         'D' },
+        { BEACON_HEADER,        0x15,   BEACON_BIT_COUNT,       'Z' },
+        { BEACON_HEADER,        0x0F3,  LTAR_BEACON_BIT_COUNT,  'E' },
+    };
+    int _count = sizeof(_frames) / sizeof(_frames[0]);
+    rmt_item32_t _items[FUZZ_MAX_ITEMS];
+
+    _batch.clear();
+    for(int index = 0; index < _count; index++)
+    {
+        _batch.addFrame(_items, encodeFrame(_items, _frames[index].header, _frames[index].data, _frames[index].bits));
+    }
+    bool _ok = _batch.decode() == _count;
+    for(int index = 0; index < _count; index++)
+    {
+        _ok = _ok && _batch.readValid(index) && _batch.readType(index) == _frames[index].type
+                  && _batch.readData(index) == _frames[index].data;
+    }
+    _ok = _ok && _batch.verify() == 0;
+    if(!_ok)    failures++;
+    printf("%-4s %d clean frames decode to their type and data\n", _ok ? "ok" : "FAIL", _count);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//Within 30% either way - well past the decoder's tolerance, so about half the durations miss.
+static uint32_t jitter(uint32_t _duration)
+{
+    int _spread = _duration * 3 / 10;
+    if(_spread == 0)    return _duration;
+    return _duration - _spread + (nextRandom() % (2 * _spread + 1));
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//One step either side of a random window edge
+static uint32_t edgeDuration()
+{
+    static const unsigned int _durations[] =
+    {
+        PRE_SYNC_MARK, PRE_SYNC_SPACE, TAG_PACKET_HEADER, BEACON_HEADER, MARK_SPACE, ZERO_BIT, ONE_BIT
+    };
+    uint16_t _min, _max;
+    ESP32_IRbatchDecoder::window(_durations[nextRandom() % 7], _min, _max);
+    int _edge = (nextRandom() & 1) ? _max : _min;
+    return _edge - 1 + (nextRandom() % 3);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+static int fuzzFrame(rmt_item32_t *_items)
+{
+    static const int _bitCounts[] =
+    {
+        TAG_BIT_COUNT, PACKET_BIT_COUNT, DATA_BIT_COUNT, BEACON_BIT_COUNT, LTAR_BEACON_BIT_COUNT
+    };
+    int _numItems;
+
+    switch(nextRandom() % 4)
+    {
+        case 0:     //a real frame, jittered
+        case 1:
+        {
+            int _bits = _bitCounts[nextRandom() % 5];
+            _numItems = encodeFrame(_items, (nextRandom() & 1) ? TAG_PACKET_HEADER : BEACON_HEADER,
+                                    nextRandom() & ((1 << _bits) - 1), _bits);
+            for(int index = 0; index < _numItems; index++)
+            {
+                if(nextRandom() % 4)    continue;       //most durations stay clean
+                setItem(_items[index], jitter(_items[index].duration0), jitter(_items[index].duration1));
+            }
+            if(nextRandom() & 1)    _items[_numItems - 1].duration1 = nextRandom() % 3000;
+            break;
+        }
+        case 2:     //window edges
+            _numItems = nextRandom() % FUZZ_MAX_ITEMS;
+            for(int index = 0; index < _numItems; index++)  setItem(_items[index], edgeDuration(), edgeDuration());
+            break;
+        default:    //noise
+            _numItems = nextRandom() % FUZZ_MAX_ITEMS;
+            for(int index = 0; index < _numItems; index++)  setItem(_items[index], nextRandom(), nextRandom());
+            break;
+    }
+    return _numItems;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char *argv[])
+{
+    int _frames = (argc > 1) ? atoi(argv[1]) : FUZZ_FRAMES;
+
+    ESP32_IRbatchDecoder _batch;
+    checkClean(_batch);
+
+    rmt_item32_t    _items[FUZZ_MAX_ITEMS];
+    int             _numItems       = 0;
+    bool            _pending        = false;
+    int             _decoded        = 0;
+    int             _valid          = 0;
+    int             _mismatches     = 0;
+    int             _batches        = 0;
+
+    _batch.clear();
+    while(_decoded < _frames)
+    {
+        if(!_pending)   _numItems = fuzzFrame(_items);
+        _pending = !_batch.addFrame(_items, _numItems);
+
+        //Full, or the end of the log - decode what's there and start the next batch.
+        if(_pending || _decoded + _batch.readFrameCount() == _frames)
+        {
+            _valid          += _batch.decode();
+            _mismatches     += _batch.verify();
+            _decoded        += _batch.readFrameCount();
+            _batches++;
+            _batch.clear();
+        }
+    }
+
+    bool _ok = _mismatches == 0 && _valid > 0 && _valid < _frames;
+    if(!_ok)    failures++;
+    printf("%-4s %d fuzzed frames in %d batches, %d valid, %d mismatches with parseLTTO()\n",
+           _ok ? "ok" : "FAIL", _decoded, _batches, _valid, _mismatches);
+
+    printf("%d failed\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,178 @@
+ /* Copyright (c) 2018 Richie Mickan. All Rights Reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>. *
+ */
+
+/* The join handshake as coroutines, on a simulated medium. One scheduler runs a host and four taggers:
+ * the host announces until everyone has joined, assigning each tagger that asks and marking it joined
+ * on its ack - repeating the assign until it is acked. Each tagger waits for an announce, asks to join
+ * after a random delay (the player pressing the button), and acks its assign, as often as it's repeated. Every tagger must join, on every seed, with a player of its own.
+ *   test_coro [seeds]     (default 10)
+ */
+
+#include "Arduino.h"
+#include "ESP32_IR_Sim.h"
+#include "ESP32_IR_Roster.h"
+#include "ESP32_IR_Coro.h"
+#include <stdio.h>
+
+#define CORO_TAGGERS        4
+#define CORO_NODES          (CORO_TAGGERS + 1)
+#define CORO_SEEDS          10
+#define CORO_GAME_ID        0x55
+#define CORO_GAME_TYPE      2
+#define CORO_TAGGER_ID      0x20        //+ node
+#define CORO_JOIN_DELAY_MS  1500        //longest wait before asking to join
+#define CORO_JOIN_TRIES     8
+#define CORO_ASSIGN_TRIES   4
+#define CORO_ACK_WAIT_MS    1000
+#define CORO_LBT_WAIT_MS    10000
+#define CORO_RUN_S          60
+#define CORO_STEP_US        1000
+
+static ESP32_IRtx<>    *tx;                 //new for each seed, their clocks are the medium's
+static ESP32_IRrx<>    *rx;
+static ESP32_IRroster   roster;
+static uint8_t          teamAndPlayer[CORO_NODES];
+static int64_t          joinedAt;
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+static IRtask host(ESP32_IRscheduler &_scheduler)
+{
+    LttoHostMessage _message;
+    LttoHostMessage _ack;
+
+    while(roster.readStateCount(SLOT_JOINED) < CORO_TAGGERS)
+    {
+        co_await irSend(tx[0], []{ return tx[0].hostPlayerToGame(0, 0, CORO_GAME_TYPE, CORO_GAME_ID, 10, 25, 99, 15, 10, 0, 0); });
+
+        //Requests (P16 gameID taggerID team), until it goes quiet
+        while(co_await irReceiveMessage(rx[0], [](const LttoHostMessage &_m){ return _m.packetID == 16 && _m.dataCount >= 3
+                                                                                && _m.data[0] == CORO_GAME_ID; },
+                                        1500, _message))
+        {
+            uint8_t _tagger = _message.data[1];
+            uint8_t _team   = _message.data[2];
+
+            //Assign until it's acked (P17 gameID taggerID) - an ack is as easily lost as an assign
+            for(int _try = 0; _try < CORO_ASSIGN_TRIES; _try++)
+            {
+                co_await irSend(tx[0], [&]{ tx[0].assignPlayer(CORO_GAME_ID, roster, _tagger, _team); });
+                if(co_await irReceiveMessage(rx[0], [&](const LttoHostMessage &_m){ return _m.packetID == 17 && _m.dataCount >= 2
+                                                                                       && _m.data[1] == _tagger; },
+                                             CORO_ACK_WAIT_MS, _ack))
+                {
+                    roster.setState(_tagger, SLOT_JOINED);
+                    break;
+                }
+            }
+        }
+    }
+    joinedAt = _scheduler.now();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+static IRtask tagger(int _node)
+{
+    LttoHostMessage _message;
+    uint8_t         _taggerID = CORO_TAGGER_ID + _node;
+
+    for(int _try = 0; _try < CORO_JOIN_TRIES; _try++)
+    {
+        co_await irReceiveMessage(rx[_node], [](const LttoHostMessage &_m){ return _m.packetID == CORO_GAME_TYPE; },
+                                  CORO_RUN_S * 1000, _message);
+        co_await irDelay(rand() % CORO_JOIN_DELAY_MS);
+
+        if(!co_await irSend(tx[_node], [&]{ return tx[_node].taggerRequestToJoin(CORO_GAME_ID, _taggerID, 0); }))   continue;
+        if(co_await irReceiveMessage(rx[_node], [&](const LttoHostMessage &_m){ return _m.packetID == 1 && _m.dataCount >= 3
+                                                                                  && _m.data[1] == _taggerID; },
+                                     2000, _message))
+        {
+            teamAndPlayer[_node] = _message.data[2];
+
+            //Ack, and again for as long as the host repeats the assign - it didn't hear the last one
+            do
+            {
+                co_await irSend(tx[_node], [&]{ tx[_node].taggerAckPlayerAssign(CORO_GAME_ID, _taggerID); });
+            } while(co_await irReceiveMessage(rx[_node], [&](const LttoHostMessage &_m){ return _m.packetID == 1 && _m.dataCount >= 3
+                                                                                          && _m.data[1] == _taggerID; },
+                                              2 * CORO_ACK_WAIT_MS, _message));
+            co_return;
+        }
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//Seconds until everyone had joined, or -1
+static double runJoin(uint32_t _seed)
+{
+    ESP32_IRmedium      _medium(CORO_NODES, _seed);
+    ESP32_IRscheduler   _scheduler(&_medium);
+
+    srand(_seed);
+    tx = new ESP32_IRtx<>[CORO_NODES];
+    rx = new ESP32_IRrx<>[CORO_NODES];
+    roster.clear();
+    joinedAt = -1;
+    for(int _node = 0; _node < CORO_NODES; _node++)
+    {
+        tx[_node].attachMedium(&_medium, _node);
+        rx[_node].attachMedium(&_medium, _node);
+        tx[_node].setListenBeforeTalk(true, CORO_LBT_WAIT_MS);
+        teamAndPlayer[_node] = 0;
+        _scheduler.attach(rx[_node]);
+    }
+
+    _scheduler.spawn(host(_scheduler));
+    for(int _node = 1; _node < CORO_NODES; _node++) _scheduler.spawn(tagger(_node));
+
+    for(int _step = 0; _step < CORO_RUN_S * 1000000 / CORO_STEP_US && _scheduler.readTaskCount() > 0; _step++)
+    {
+        _medium.advance(CORO_STEP_US);
+        _scheduler.poll();
+    }
+    bool _ok = _scheduler.readTaskCount() == 0;
+
+    //Every tagger has its own player
+    for(int _node = 1; _node < CORO_NODES; _node++)
+    {
+        for(int _other = 1; _other < _node; _other++)
+        {
+            if(teamAndPlayer[_node] == teamAndPlayer[_other])   _ok = false;
+        }
+    }
+    delete[] tx;
+    delete[] rx;
+    return _ok ? joinedAt / 1000000.0 : -1;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char *argv[])
+{
+    int     _seeds      = (argc > 1) ? atoi(argv[1]) : CORO_SEEDS;
+    int     _failures   = 0;
+
+    for(int _seed = 1; _seed <= _seeds; _seed++)
+    {
+        double _seconds = runJoin(_seed);
+        if(_seconds < 0)    _failures++;
+        printf("%-4s seed %2d  %d taggers joined in %5.1f s\n", _seconds < 0 ? "FAIL" : "ok", _seed,
+               roster.readStateCount(SLOT_JOINED), _seconds);
+    }
+    printf("%d failed\n", _failures);
+    return _failures ? 1 : 0;
+}
@@ -0,0 +1,248 @@
+ /* Copyright (c) 2018 Richie Mickan. All Rights Reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>. *
+ */
+
+/* Edge capture without the hardware. Encoded frames go in as edges through feedEdge() and setTime(),
+ * and must come out as the same items, decoding with parseLTTO(). Bursts are split on RX_IDLE_US of
+ * quiet, a full queue drops edges without wrecking the bursts after it, and the pin interrupt (run by
+ * shimEdge()) and every receive() call are costed.
+ */
+
+#include "Arduino.h"
+#include "ESP32_IR_Edge.h"
+#include "shim.h"
+#include <stdio.h>
+#include <vector>
+
+#define EDGE_PIN        7
+
+static int failures = 0;
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+static void check(bool _ok, const char *_what)
+{
+    if(!_ok)    failures++;
+    printf("%-4s %s\n", _ok ? "ok" : "FAIL", _what);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+static rmt_item32_t item(uint32_t _mark, uint32_t _space)
+{
+    rmt_item32_t _item;
+    _item.duration0 = _mark;
+    _item.level0    = 0;            //IR receivers are active low, as the RMT gives them
+    _item.duration1 = _space;
+    _item.level1    = 1;
+    return _item;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//A burst as the receiver sees it - the last bit has no space.
+static std::vector<rmt_item32_t> encodeBurst(unsigned int _header, uint32_t _data, int _bitCount)
+{
+    std::vector<rmt_item32_t> _items;
+    _items.push_back(item(PRE_SYNC_MARK, PRE_SYNC_SPACE));
+    _items.push_back(item(_header, MARK_SPACE));
+    for(int index = _bitCount - 1; index >= 0; index--)
+    {
+        _items.push_back(item(((_data >> index) & 1) ? ONE_BIT : ZERO_BIT, index ? MARK_SPACE : 0));
+    }
+    return _items;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//Feeds the burst's edges from _start, and returns the time of the last one.
+static int64_t feedBurst(ESP32_IRedgeCapture &_capture, int _sensor, const std::vector<rmt_item32_t> &_items, int64_t _start)
+{
+    int64_t _time = _start;
+    for(size_t index = 0; index < _items.size(); index++)
+    {
+        _capture.feedEdge(_sensor, 0, _time);
+        _time += _items[index].duration0;
+        _capture.feedEdge(_sensor, 1, _time);
+        _time += _items[index].duration1;
+    }
+    return _time;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+static bool sameDurations(const rmt_item32_t *_items, int _numItems, const std::vector<rmt_item32_t> &_expected)
+{
+    if(_numItems != (int)_expected.size())  return false;
+    for(int index = 0; index < _numItems; index++)
+    {
+        if(_items[index].duration0 != _expected[index].duration0 || _items[index].duration1 != _expected[index].duration1)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//A burst is only handed over once RX_IDLE_US has passed, item for item, and decodes.
+static void checkDecode(ESP32_IRedgeCapture &_capture, int _sensor)
+{
+    static const struct { unsigned int header; uint32_t data; int bits; char type; } _frames[] =
+    {
+        { TAG_PACKET_HEADER,    0x2B,   TAG_BIT_COUNT,          'T' },
+        { TAG_PACKET_HEADER,    0x02,   PACKET_BIT_COUNT,       'P' },
+        { TAG_PACKET_HEADER,    0xC3,   DATA_BIT_COUNT,         'D' },
+        { BEACON_HEADER,        0x15,   BEACON_BIT_COUNT,       'Z' },
+    };
+    int64_t _time   = 1000000;
+    bool    _ok     = true;
+
+    for(size_t index = 0; index < sizeof(_frames) / sizeof(_frames[0]); index++)
+    {
+        std::vector<rmt_item32_t> _burst = encodeBurst(_frames[index].header, _frames[index].data, _frames[index].bits);
+        int64_t         _end    = feedBurst(_capture, _sensor, _burst, _time);
+        rmt_item32_t   *_items  = NULL;
+        int64_t         _lastEdgeTime;
+
+        _capture.setTime(_end + RX_IDLE_US - 1);
+        _ok = _ok && _capture.receive(_sensor, &_items) == 0;
+
+        _capture.setTime(_end + RX_IDLE_US);
+        int _numItems = _capture.receive(_sensor, &_items, &_lastEdgeTime);
+        LttoMessage _message;
+        _ok = _ok && sameDurations(_items, _numItems, _burst) && _lastEdgeTime == _end
+                  && ESP32_IRrxBase::parseLTTO(_items, _numItems, _message)
+                  && _message.type == _frames[index].type && _message.data == _frames[index].data;
+        _time = _end + 50000;
+    }
+    check(_ok, "fed edges come out as the encoded items, and decode");
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//RX_IDLE_US of quiet ends a burst, whether the edge after it is queued already or the clock gets there
+//first. One microsecond less, and the two run together.
+static void checkIdleSplit(ESP32_IRedgeCapture &_capture, int _sensor)
+{
+    std::vector<rmt_item32_t> _tag      = encodeBurst(TAG_PACKET_HEADER, 0x2B, TAG_BIT_COUNT);
+    std::vector<rmt_item32_t> _beacon   = encodeBurst(BEACON_HEADER, 0x15, BEACON_BIT_COUNT);
+    rmt_item32_t   *_items  = NULL;
+    int64_t         _time   = 2000000;
+
+    int64_t _tagEnd     = feedBurst(_capture, _sensor, _tag, _time);
+    int64_t _beaconEnd  = feedBurst(_capture, _sensor, _beacon, _tagEnd + RX_IDLE_US);
+    _capture.setTime(_beaconEnd + 1);
+    bool _ok = sameDurations(_items, _capture.receive(_sensor, &_items), _tag);
+    _ok = _ok && _capture.receive(_sensor, &_items) == 0;                  //the beacon isn't over yet
+    _capture.setTime(_beaconEnd + RX_IDLE_US);
+    _ok = _ok && sameDurations(_items, _capture.receive(_sensor, &_items), _beacon);
+    _ok = _ok && _capture.receive(_sensor, &_items) == 0;
+    check(_ok, "RX_IDLE_US of quiet splits two bursts");
+
+    std::vector<rmt_item32_t> _joined = _tag;
+    _joined.back().duration1 = RX_IDLE_US - 1;
+    _joined.insert(_joined.end(), _tag.begin(), _tag.end());
+    int64_t _end = feedBurst(_capture, _sensor, _joined, _beaconEnd + 50000);
+    _capture.setTime(_end + RX_IDLE_US);
+    _ok = sameDurations(_items, _capture.receive(_sensor, &_items), _joined);
+    check(_ok, "a gap just under RX_IDLE_US doesn't");
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//Edges that don't fit are counted and dropped, and the next burst still comes out whole - even
+//though the queue lost the end of a mark.
+static void checkOverflow(ESP32_IRedgeCapture &_capture, int _sensor)
+{
+    std::vector<rmt_item32_t> _tag      = encodeBurst(TAG_PACKET_HEADER, 0x2B, TAG_BIT_COUNT);
+    std::vector<rmt_item32_t> _flood(EDGE_QUEUE_SIZE, item(ZERO_BIT, MARK_SPACE));
+    rmt_item32_t   *_items  = NULL;
+    int64_t         _time   = 3000000;
+
+    _capture.clearSensorStats();
+    int64_t _end = feedBurst(_capture, _sensor, _flood, _time);
+    EdgeSensorStats _stats = _capture.readSensorStats(_sensor);
+    bool _ok = _stats.edges == 2 * EDGE_QUEUE_SIZE && _stats.droppedEdges == EDGE_QUEUE_SIZE + 1;
+
+    _capture.setTime(_end + RX_IDLE_US);
+    while(_capture.receive(_sensor, &_items) > 0);                          //whatever was queued
+
+    _end = feedBurst(_capture, _sensor, _tag, _end + 50000);
+    _capture.setTime(_end + RX_IDLE_US);
+    LttoMessage _message;
+    int _numItems = _capture.receive(_sensor, &_items);
+    _ok = _ok && sameDurations(_items, _numItems, _tag)
+              && ESP32_IRrxBase::parseLTTO(_items, _numItems, _message) && _message.data == 0x2B;
+    check(_ok, "a full queue drops edges, and the next burst is still whole");
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//The pin interrupt and receive() are costed per sensor, polls that find nothing included.
+static void checkCost()
+{
+    ESP32_IRedgeCapture _capture;
+    int _sensor = _capture.addSensor(EDGE_PIN);
+    _capture.begin();
+
+    std::vector<rmt_item32_t> _tag = encodeBurst(TAG_PACKET_HEADER, 0x2B, TAG_BIT_COUNT);
+    rmt_item32_t   *_items  = NULL;
+    int64_t         _time   = 4000000;
+
+    shimNow = _time;
+    _capture.clearSensorStats();
+    for(size_t index = 0; index < _tag.size(); index++)
+    {
+        shimEdge(EDGE_PIN, _time);
+        _time += _tag[index].duration0;
+        shimEdge(EDGE_PIN, _time);
+        _time += _tag[index].duration1;
+    }
+    int _polls = 0;
+    int _numItems = 0;
+    while(_numItems == 0)
+    {
+        shimNow = _time + _polls * 1000;
+        _numItems = _capture.receive(_sensor, &_items);
+        _polls++;
+    }
+    EdgeSensorStats _stats = _capture.readSensorStats(_sensor);
+    _capture.end();
+
+    bool _ok = sameDurations(_items, _numItems, _tag) && _stats.edges == 2 * _tag.size() && _stats.bursts == 1
+            && (int)_stats.receiveCalls == _polls && _polls > 1
+            && _stats.isrCyclesAvg > 0 && _stats.assembleCyclesAvg > 0
+            && _stats.cyclesPerBurst >= _stats.isrCyclesAvg * _stats.edges && _stats.cyclesPerSecond > 0;
+    check(_ok, "the interrupt and every receive() call are costed");
+    printf("     %u edges, %u receive() calls: %u ns per edge, %u ns per call, %u ns per burst (host nanoseconds)\n",
+           _stats.edges, _stats.receiveCalls, _stats.isrCyclesAvg, _stats.assembleCyclesAvg, _stats.cyclesPerBurst);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+    ESP32_IRedgeCapture _capture;
+    int _sensor = _capture.addSensor(-1);           //fed by hand, no pin
+
+    checkDecode(_capture, _sensor);
+    checkIdleSplit(_capture, _sensor);
+    checkOverflow(_capture, _sensor);
+    checkCost();
+
+    printf("%d failed\n", failures);
+    return failures ? 1 : 0;
+}
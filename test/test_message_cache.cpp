@@ -0,0 +1,118 @@
+ /* Copyright (c) 2018 Richie Mickan. All Rights Reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>. *
+ */
+
+/* The receiver's message cache, on a simulated medium - a host announces, a receiver on the other
+ * node decodes. A repeat inside MESSAGE_CACHE_MS of the last copy is flagged and not delivered again,
+ * one after it is new, and with MESSAGE_CACHE_SIZE messages remembered the least recently seen one
+ * makes way for the next.
+ */
+
+#include "Arduino.h"
+#include "ESP32_IR_Sim.h"
+#include <stdio.h>
+
+#define CACHE_STEP_US       1000
+#define CACHE_GAME_ID       0x40            //+ n, for different announces
+#define CACHE_LONG_MS       60000           //a window the LRU test can't outlast
+
+static int failures = 0;
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+static void check(bool _ok, const char *_what)
+{
+    if(!_ok)    failures++;
+    printf("%-4s %s\n", _ok ? "ok" : "FAIL", _what);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+static void run(ESP32_IRmedium &_medium, ESP32_IRrxBase &_rx, int64_t _until)
+{
+    while(_medium.now() < _until)
+    {
+        _medium.advance(CACHE_STEP_US);
+        ESP32_IRrxItem _rxItem = _rx.receiveItem(0);
+        if(_rxItem) _rx.decodeIR(_rxItem);
+    }
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//One announce, from end to end. 'N'ew, 'R'epeat, or '-' if it didn't complete.
+static char announce(ESP32_IRmedium &_medium, ESP32_IRtxBase &_tx, ESP32_IRrxBase &_rx, uint8_t _game)
+{
+    uint32_t _count = _rx.readMessageCount();
+    uint32_t _hits  = _rx.readMessageCacheHits();
+
+    _tx.hostPlayerToGame(0, 0, 2, CACHE_GAME_ID + _game, 10, 25, 99, 15, 0, 0, 0);
+    run(_medium, _rx, _tx.readTxDoneTime() + RX_IDLE_US + CACHE_STEP_US);
+
+    bool _new = _rx.messageAvailable();
+    if(_rx.readMessageCount() != _count + 1)    return '-';
+    if(_new && !_rx.readMessageRepeated() && _rx.readMessageCacheHits() == _hits)       return 'N';
+    if(!_new && _rx.readMessageRepeated() && _rx.readMessageCacheHits() == _hits + 1)  return 'R';
+    return '-';
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+static void idle(ESP32_IRmedium &_medium, ESP32_IRrxBase &_rx, uint32_t _ms)
+{
+    run(_medium, _rx, _medium.now() + (int64_t)_ms * 1000);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+    ESP32_IRmedium  _medium(2);
+    ESP32_IRtx<>    _tx;
+    ESP32_IRrx<>    _rx;
+    _tx.attachMedium(&_medium, 0);
+    _rx.attachMedium(&_medium, 1);
+
+    bool _ok = announce(_medium, _tx, _rx, 0) == 'N' && announce(_medium, _tx, _rx, 0) == 'R';
+    _ok = _ok && announce(_medium, _tx, _rx, 1) == 'N' && announce(_medium, _tx, _rx, 0) == 'R';
+    check(_ok, "the same announce twice is a hit, and isn't delivered again");
+
+    //The window runs from the last copy - an announce takes 0.7 S, so 4 S of quiet is still inside it
+    idle(_medium, _rx, MESSAGE_CACHE_MS - 1000);
+    _ok = announce(_medium, _tx, _rx, 0) == 'R';
+    idle(_medium, _rx, MESSAGE_CACHE_MS);
+    _ok = _ok && announce(_medium, _tx, _rx, 0) == 'N' && announce(_medium, _tx, _rx, 0) == 'R';
+    check(_ok, "MESSAGE_CACHE_MS after the last copy it is new again");
+
+    //Fill the cache, see the first again, and the next new one pushes out the second
+    _rx.setMessageCacheWindow(CACHE_LONG_MS);
+    idle(_medium, _rx, MESSAGE_CACHE_MS);
+    _ok = true;
+    for(int _game = 0; _game < MESSAGE_CACHE_SIZE; _game++)  _ok = _ok && announce(_medium, _tx, _rx, 10 + _game) == 'N';
+    _ok = _ok && announce(_medium, _tx, _rx, 10) == 'R';
+    _ok = _ok && announce(_medium, _tx, _rx, 10 + MESSAGE_CACHE_SIZE) == 'N';
+    _ok = _ok && announce(_medium, _tx, _rx, 10) == 'R' && announce(_medium, _tx, _rx, 10 + MESSAGE_CACHE_SIZE - 1) == 'R';
+    _ok = _ok && announce(_medium, _tx, _rx, 11) == 'N';
+    check(_ok, "a full cache forgets the least recently seen message");
+
+    _rx.setMessageCacheWindow(0);
+    _ok = announce(_medium, _tx, _rx, 10) == 'N' && announce(_medium, _tx, _rx, 10) == 'N';
+    check(_ok, "setMessageCacheWindow(0) makes every copy new");
+
+    _rx.clearMessageCacheCounters();
+    check(_rx.readMessageCount() == 0 && _rx.readMessageCacheHits() == 0, "clearMessageCacheCounters()");
+
+    printf("%d failed\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,178 @@
+ /* Copyright (c) 2018 Richie Mickan. All Rights Reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>. *
+ */
+
+/* The pipeline on the shim's threads. A feeder thread plays the RMT, putting the packets of a hosting
+ * message into the receiver's ring buffer. The Rx task decodes them, the main thread is the sketch,
+ * reading messages and queueing tags for the Tx task, all at once. Every burst must come out as a
+ * message, every hosting message must complete, every tag must be sent, and end() must return -
+ * also straight after begin().
+ * The rates are printed - they are the PC's, not the ESP32's, and only show where a change costs.
+ *   test_pipeline [messages]     (default 20000 hosting messages)
+ */
+
+#include "Arduino.h"
+#include "ESP32_IR_Pipeline.h"
+#include "shim.h"
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#define BENCH_MESSAGES      20000
+#define BENCH_RING_SIZE     16384
+#define BENCH_FEED_BYTES    (BENCH_RING_SIZE / 4)   //well under the shed watermark
+#define BENCH_IN_FLIGHT     (PIPELINE_RX_QUEUE / 2) //bursts fed and not yet read, so none are dropped
+#define BENCH_TX_SENDS      20000
+#define RESTARTS            100
+#define BENCH_RX_CHANNEL    1
+#define BENCH_TIMEOUT_S     60
+
+static int failures = 0;
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//The packets of the frame last written to the RMT, as the receiver would get them - the marks up to
+//each gap, the last bit with no space.
+static std::vector<std::vector<rmt_item32_t>> capturePackets()
+{
+    std::vector<std::vector<rmt_item32_t>> _packets;
+    size_t index = 0;
+
+    while(index < shimItems.size())
+    {
+        std::vector<rmt_item32_t> _packet;
+        while(index < shimItems.size() && shimItems[index].level0)    _packet.push_back(shimItems[index++]);
+        while(index < shimItems.size() && !shimItems[index].level0)   index++;
+        if(_packet.empty()) break;          //end marker
+        _packet.back().duration1 = 0;
+        _packets.push_back(_packet);
+    }
+    return _packets;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+static void check(bool _ok, const char *_what)
+{
+    if(!_ok)    failures++;
+    printf("%-4s %s\n", _ok ? "ok" : "FAIL", _what);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+int main(int argc, char *argv[])
+{
+    int _messages = (argc > 1) ? atoi(argv[1]) : BENCH_MESSAGES;
+
+    ESP32_IRtx<>                _tx;
+    ESP32_IRrx<BENCH_RING_SIZE> _rx;
+    _tx.ESP32_IRtxPIN(4, 0);
+    _tx.initTransmit();
+    _rx.ESP32_IRrxPIN(5, BENCH_RX_CHANNEL);
+    _rx.initReceive();
+
+    _tx.hostPlayerToGame(0, 0, 2, 0x40, 10, 25, 99, 15, 0, 0, 0);    //packet 2 (game type), 8 data, checksum
+    std::vector<std::vector<rmt_item32_t>> _packets = capturePackets();
+    int _bursts = _messages * _packets.size();
+
+    ESP32_IRpipeline _pipeline;
+    check(_pipeline.attach(_rx), "attach()");
+    check(_pipeline.begin(), "begin() starts both tasks");
+    if(failures)
+    {
+        printf("%d failed\n", failures);
+        return 1;
+    }
+
+    auto _start = std::chrono::steady_clock::now();
+
+    //The RMT - as fast as the sketch keeps up, without ever filling the ring buffer or the Rx queue.
+    //A sketch that falls behind loses messages (rxDropped), that isn't what's being measured here.
+    std::atomic<int> _received(0);
+    std::thread _feeder([&]()
+    {
+        for(int _burst = 0; _burst < _bursts; _burst++)
+        {
+            const std::vector<rmt_item32_t> &_packet = _packets[_burst % _packets.size()];
+            while(_burst - _received > BENCH_IN_FLIGHT || shimRxBacklog(BENCH_RX_CHANNEL) > BENCH_FEED_BYTES
+                  || !shimReceive(BENCH_RX_CHANNEL, _packet.data(), _packet.size()))
+            {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    //The sketch
+    int                 _completed  = 0;
+    int                 _badMessage = 0;
+    int                 _queued     = 0;
+    double              _txSeconds  = 0;
+    IRpipelineMessage   _message;
+    while(_received < _bursts || (int)_pipeline.readStats().sends < BENCH_TX_SENDS)
+    {
+        if(std::chrono::steady_clock::now() - _start > std::chrono::seconds(BENCH_TIMEOUT_S)) break;
+
+        bool _idle = true;
+        while(_pipeline.read(_message))
+        {
+            _idle = false;
+            _received++;
+            if(!_message.hostMessageDone)   continue;
+            _completed++;
+            if(_message.hostMessage.packetID != 2 || _message.hostMessage.dataCount != (int)_packets.size() - 2) _badMessage++;
+        }
+        if(_queued < BENCH_TX_SENDS && _pipeline.queueTag(_tx, 1, _queued % 8 + 1, 3))
+        {
+            _idle = false;
+            _queued++;
+        }
+        if(_txSeconds == 0 && (int)_pipeline.readStats().sends == BENCH_TX_SENDS)
+        {
+            _txSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+        }
+        if(_idle)   std::this_thread::yield();
+    }
+    double _seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+    _feeder.join();
+
+    IRpipelineStats _stats = _pipeline.readStats();
+    _pipeline.end();
+
+    printf("     %d bursts in %.2f s - %.0f bursts/s through the Rx task\n", _stats.bursts, _seconds, _stats.bursts / _seconds);
+    printf("     %d sends in %.2f s - %.0f sends/s through the Tx task at the same time\n",
+           _stats.sends, _txSeconds, _txSeconds > 0 ? _stats.sends / _txSeconds : 0);
+    printf("     messages %u, rxDropped %u, sends %u, txDropped %u (the sketch retries those)\n",
+           _stats.messages, _stats.rxDropped, _stats.sends, _stats.txDropped);
+
+    check(_received == _bursts && (int)_stats.bursts == _bursts && (int)_stats.messages == _bursts,
+          "every burst decoded and read");
+    check(_completed == _messages && _badMessage == 0, "every hosting message completed");
+    check((int)_stats.sends == BENCH_TX_SENDS, "every queued tag sent");
+    check(!_pipeline.isRunning(), "end() stops both tasks");
+
+    //end() straight after begin(), before the tasks are into their loops
+    int _restarts = 0;
+    for(int index = 0; index < RESTARTS; index++)
+    {
+        if(!_pipeline.begin())  break;
+        _pipeline.end();
+        if(!_pipeline.isRunning())  _restarts++;
+    }
+    check(_restarts == RESTARTS, "begin() and end() back to back");
+
+    printf("%d failed\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,198 @@
+ /* Copyright (c) 2018 Richie Mickan. All Rights Reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>. *
+ */
+
+/* The host's roster. Teams stay within one player of each other whatever the taggers prefer, solo
+ * players' codes overlap team 1's and decode by the kind of game, a removed tagger's slot and player
+ * go to the next one to join, and a full game (or team) turns the next tagger away.
+ */
+
+#include "Arduino.h"
+#include "ESP32_IR_Roster.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define ROSTER_SEEDS        50
+
+static int failures = 0;
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+static void check(bool _ok, const char *_what)
+{
+    if(!_ok)    failures++;
+    printf("%-4s %s\n", _ok ? "ok" : "FAIL", _what);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+static bool onTeam(ESP32_IRroster &_roster, uint8_t _taggerID, uint8_t _team, uint8_t _player)
+{
+    int _slot = _roster.findTagger(_taggerID);
+    if(_slot < 0)   return false;
+    const RosterSlot &_entry = _roster.readSlot(_slot);
+    return _entry.teamNumber == _team && _entry.playerNumber == _player
+        && _entry.teamAndPlayer == ESP32_IRroster::encodeTeamAndPlayer(_team, _player)
+        && _roster.findTeamAndPlayer(_entry.teamAndPlayer) == _slot;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//A tagger gets its preferred team only while that team is one of the smallest.
+static void checkPickTeam()
+{
+    ESP32_IRroster _roster(true, 3);
+
+    _roster.addTagger(1, 1);
+    _roster.addTagger(2, 1);                                //team 1 would be 2 ahead
+    _roster.addTagger(3, 3);
+    _roster.addTagger(4, 2);                                //all level, so it gets team 2
+    _roster.addTagger(5, 2);                                //team 2 would be 2 ahead - team 1 is the first smallest
+    _roster.addTagger(6, 0);                                //no preference
+    bool _ok = onTeam(_roster, 1, 1, 1) && onTeam(_roster, 2, 2, 1) && onTeam(_roster, 3, 3, 1)
+            && onTeam(_roster, 4, 2, 2) && onTeam(_roster, 5, 1, 2) && onTeam(_roster, 6, 3, 2);
+    _ok = _ok && _roster.addTagger(1, 3) == _roster.findTagger(1) && onTeam(_roster, 1, 1, 1);   //asked again
+    check(_ok, "the preferred team, unless it would be two players ahead");
+
+    //Any preferences, the teams never drift apart
+    _ok = true;
+    for(int _seed = 1; _seed <= ROSTER_SEEDS; _seed++)
+    {
+        srand(_seed);
+        _roster.setGameType(true, 3);
+        for(int _tagger = 0; _tagger < MAX_ROSTER_PLAYERS; _tagger++)
+        {
+            _ok = _ok && _roster.addTagger(_tagger, rand() % 4) >= 0;
+            int _min = _roster.readTeamCount(1);
+            int _max = _min;
+            for(uint8_t _team = 2; _team <= 3; _team++)
+            {
+                if(_roster.readTeamCount(_team) < _min) _min = _roster.readTeamCount(_team);
+                if(_roster.readTeamCount(_team) > _max) _max = _roster.readTeamCount(_team);
+            }
+            _ok = _ok && _max - _min <= 1 && _roster.readPlayerCount() == _tagger + 1;
+        }
+    }
+    check(_ok, "random preferences keep the teams within one player");
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//Team codes are (team << 3) + player - 1, solo codes player + 7 - so solo 1-8 are team 1's codes.
+static void checkTeamAndPlayer()
+{
+    bool    _ok = true;
+    uint8_t _team, _player;
+
+    for(uint8_t _t = 1; _t <= MAX_ROSTER_TEAMS; _t++)
+    {
+        for(uint8_t _p = 1; _p <= ROSTER_TEAM_SIZE; _p++)
+        {
+            uint8_t _code = ESP32_IRroster::encodeTeamAndPlayer(_t, _p);
+            _ok = _ok && ESP32_IRroster::decodeTeamAndPlayer(_code, true, _team, _player) && _team == _t && _player == _p;
+            _ok = _ok && ESP32_IRroster::decodeTeamAndPlayer(_code | 0xE0, true, _team, _player) && _team == _t && _player == _p;
+        }
+    }
+    for(uint8_t _p = 1; _p <= MAX_ROSTER_PLAYERS; _p++)
+    {
+        uint8_t _code = ESP32_IRroster::encodeTeamAndPlayer(0, _p);
+        _ok = _ok && ESP32_IRroster::decodeTeamAndPlayer(_code, false, _team, _player) && _team == 0 && _player == _p;
+    }
+    for(uint8_t _code = 0; _code < 8; _code++)
+    {
+        _ok = _ok && !ESP32_IRroster::decodeTeamAndPlayer(_code, true, _team, _player)
+                  && !ESP32_IRroster::decodeTeamAndPlayer(_code, false, _team, _player) && _team == 0 && _player == 0;
+    }
+    check(_ok, "decodeTeamAndPlayer() undoes encodeTeamAndPlayer(), codes under 8 are invalid");
+
+    //The overlap
+    _ok = ESP32_IRroster::encodeTeamAndPlayer(0, 1) == ESP32_IRroster::encodeTeamAndPlayer(1, 1);
+    _ok = _ok && ESP32_IRroster::decodeTeamAndPlayer(8, false, _team, _player) && _team == 0 && _player == 1;
+    _ok = _ok && ESP32_IRroster::decodeTeamAndPlayer(8, true, _team, _player)  && _team == 1 && _player == 1;
+    _ok = _ok && ESP32_IRroster::decodeTeamAndPlayer(31, false, _team, _player) && _team == 0 && _player == 24;
+    _ok = _ok && ESP32_IRroster::decodeTeamAndPlayer(31, true, _team, _player)  && _team == 3 && _player == 8;
+
+    ESP32_IRroster _roster(false);
+    for(int _tagger = 0; _tagger < MAX_ROSTER_PLAYERS; _tagger++)   _roster.addTagger(50 + _tagger, 2);
+    for(int _tagger = 0; _tagger < MAX_ROSTER_PLAYERS; _tagger++)
+    {
+        _ok = _ok && onTeam(_roster, 50 + _tagger, 0, _tagger + 1);
+    }
+    check(_ok && _roster.readTeamCount(0) == MAX_ROSTER_PLAYERS, "solo players are player + 7, overlapping team 1");
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//A removed tagger frees its slot, its player and its codes, and the next to join gets them.
+static void checkRemove()
+{
+    ESP32_IRroster _roster(true, 2);
+
+    _roster.addTagger(10, 1);
+    int _slot = _roster.addTagger(11, 2);
+    _roster.addTagger(12, 1);
+    _roster.addTagger(13, 2);
+    uint8_t _code = _roster.readSlot(_slot).teamAndPlayer;
+
+    bool _ok = _roster.removeTagger(11) && !_roster.removeTagger(11) && !_roster.removeTagger(99);
+    _ok = _ok && _roster.findTagger(11) < 0 && _roster.findTeamAndPlayer(_code) < 0
+              && _roster.readSlot(_slot).state == SLOT_FREE && _roster.readPlayerCount() == 3
+              && _roster.readTeamCount(1) == 2 && _roster.readTeamCount(2) == 1 && !_roster.setState(11, SLOT_JOINED);
+    check(_ok, "removeTagger() frees the slot and the player");
+
+    _ok = _roster.addTagger(14, 2) == _slot && onTeam(_roster, 14, 2, 1);          //11's old place
+    _ok = _ok && _roster.addTagger(11, 2) == 4 && onTeam(_roster, 11, 2, 3);        //back, as a new player
+    _ok = _ok && _roster.readPlayerCount() == 5 && _roster.readStateCount(SLOT_ASSIGNED) == 5;
+    check(_ok, "the next tagger gets them, and the removed one comes back as a new player");
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//-1 once there is no room - a tagger already on the roster still gets its slot.
+static void checkFull()
+{
+    ESP32_IRroster _roster(true, 3);
+    bool _ok = true;
+
+    for(int _tagger = 0; _tagger < MAX_ROSTER_PLAYERS; _tagger++)   _ok = _ok && _roster.addTagger(_tagger, 1) >= 0;
+    _ok = _ok && _roster.addTagger(100, 1) == -1 && _roster.readPlayerCount() == MAX_ROSTER_PLAYERS;
+    _ok = _ok && _roster.addTagger(5, 1) == _roster.findTagger(5);
+    check(_ok, "a full team game returns -1");
+
+    _roster.setGameType(true, 1);
+    _ok = true;
+    for(int _tagger = 0; _tagger < ROSTER_TEAM_SIZE; _tagger++)     _ok = _ok && _roster.addTagger(_tagger, 1) >= 0;
+    _ok = _ok && _roster.addTagger(100, 1) == -1 && _roster.readTeamCount(1) == ROSTER_TEAM_SIZE;
+    check(_ok, "one team holds ROSTER_TEAM_SIZE");
+
+    _roster.setGameType(false);
+    _ok = true;
+    for(int _tagger = 0; _tagger < MAX_ROSTER_PLAYERS; _tagger++)   _ok = _ok && _roster.addTagger(_tagger) >= 0;
+    _ok = _ok && _roster.addTagger(100) == -1;
+    _ok = _ok && _roster.removeTagger(7) && _roster.addTagger(100) >= 0 && onTeam(_roster, 100, 0, 8);
+    check(_ok, "a full solo game returns -1, until someone leaves");
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+    checkPickTeam();
+    checkTeamAndPlayer();
+    checkRemove();
+    checkFull();
+
+    printf("%d failed\n", failures);
+    return failures ? 1 : 0;
+}
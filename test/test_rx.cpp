@@ -0,0 +1,292 @@
+ /* Copyright (c) 2018 Richie Mickan. All Rights Reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>. *
+ */
+
+/* Receiver paths that don't need a second device - bursts are put straight into the RMT ring buffer,
+ * and their edges raised on the Rx pin, as the hardware would.
+ */
+
+#include "Arduino.h"
+#include "ESP32_IR_LTTO.h"
+#include "shim.h"
+#include <stdio.h>
+#include <vector>
+
+#define RX_PIN          5
+#define RX_CHANNEL      1
+
+static int failures = 0;
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+static void check(bool _ok, const char *_what)
+{
+    if(!_ok)    failures++;
+    printf("%-4s %s\n", _ok ? "ok" : "FAIL", _what);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+static rmt_item32_t item(uint32_t _mark, uint32_t _space)
+{
+    rmt_item32_t _item;
+    _item.duration0 = _mark;
+    _item.level0    = 1;
+    _item.duration1 = _space;
+    _item.level1    = 0;
+    return _item;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//A burst as the RMT hands it over - the last bit has no space, the burst ended on the idle threshold.
+static std::vector<rmt_item32_t> encodeBurst(unsigned int _header, uint32_t _data, int _bitCount)
+{
+    std::vector<rmt_item32_t> _items;
+    _items.push_back(item(PRE_SYNC_MARK, PRE_SYNC_SPACE));
+    _items.push_back(item(_header, MARK_SPACE));
+    for(int index = _bitCount - 1; index >= 0; index--)
+    {
+        _items.push_back(item(((_data >> index) & 1) ? ONE_BIT : ZERO_BIT, index ? MARK_SPACE : 0));
+    }
+    return _items;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//Raises the burst's edges on the Rx pin from _start, and returns the time of the last one.
+static int64_t playEdges(const std::vector<rmt_item32_t> &_items, int64_t _start)
+{
+    int64_t _time = _start;
+    for(size_t index = 0; index < _items.size(); index++)
+    {
+        shimEdge(RX_PIN, _time);
+        _time += _items[index].duration0;
+        shimEdge(RX_PIN, _time);
+        _time += _items[index].duration1;
+    }
+    return _time;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//Every item taken from the ring buffer gets its own burst's end, even with bursts missing on the way:
+//edges the RMT filtered out entirely, a burst the glitch filter empties, and a burst lost to a full
+//ring buffer.
+static void checkBurstEnds(ESP32_IRrxBase &_rx)
+{
+    std::vector<rmt_item32_t> _tag      = encodeBurst(TAG_PACKET_HEADER, 0x2B, TAG_BIT_COUNT);
+    std::vector<rmt_item32_t> _packet   = encodeBurst(TAG_PACKET_HEADER, 0x02, PACKET_BIT_COUNT);
+    std::vector<rmt_item32_t> _beacon   = encodeBurst(BEACON_HEADER,     0x15, BEACON_BIT_COUNT);
+    std::vector<rmt_item32_t> _noise    = { item(50, 0) };
+    std::vector<rmt_item32_t> _glitches = { item(100, 300), item(100, 300), item(100, 0) };
+
+    _rx.setLatencyTracing(true);
+    int64_t _time = 100000;
+
+    int64_t _tagEnd     = playEdges(_tag, _time);               shimReceive(RX_CHANNEL, _tag.data(), _tag.size());
+    _time               = playEdges(_noise, _tagEnd + 20000);   //too short for the RMT's filter
+    _time               = playEdges(_glitches, _time + 20000);  shimReceive(RX_CHANNEL, _glitches.data(), _glitches.size());
+    _time               = playEdges(_packet, _time + 20000);    //the ring buffer was full
+    int64_t _tag2End    = playEdges(_tag, _time + 20000);       shimReceive(RX_CHANNEL, _tag.data(), _tag.size());
+    int64_t _beaconEnd  = playEdges(_beacon, _tag2End + 20000); shimReceive(RX_CHANNEL, _beacon.data(), _beacon.size());
+    shimNow = _beaconEnd + RX_IDLE_US + 1000;
+
+    ESP32_IRrxItem _first   = _rx.receiveItem(0);
+    bool _ok = _first && _first.readLastEdgeTime() == _tagEnd;
+    _first = ESP32_IRrxItem();
+    ESP32_IRrxItem _second  = _rx.receiveItem(0);               //the glitches are taken on the way
+    _ok = _ok && _second && _second.size() == (int)_tag.size() && _second.readLastEdgeTime() == _tag2End;
+    _second = ESP32_IRrxItem();
+    ESP32_IRrxItem _third   = _rx.receiveItem(0);               //still in lastEdge, nothing came after
+    _ok = _ok && _third && _third.readLastEdgeTime() == _beaconEnd;
+    _third = ESP32_IRrxItem();
+    _ok = _ok && !_rx.receiveItem(0);
+
+    _rx.setLatencyTracing(false);
+    check(_ok, "burst ends stay matched past filtered, glitch-only and dropped bursts");
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//NEC: 9mS leader, 4.5mS space, then 32 bits of 560uS marks
+static std::vector<rmt_item32_t> encodeNEC(uint32_t _data)
+{
+    std::vector<rmt_item32_t> _items;
+    _items.push_back(item(9000, 4500));
+    for(int index = 31; index >= 0; index--)    _items.push_back(item(560, ((_data >> index) & 1) ? 1690 : 560));
+    _items.push_back(item(560, 0));
+    return _items;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//Through the ring buffer, as the sketch would
+static bool decodeBurst(ESP32_IRrxBase &_rx, const std::vector<rmt_item32_t> &_items)
+{
+    shimReceive(RX_CHANNEL, _items.data(), _items.size());
+    return _rx.decodeIR(_rx.receiveItem(0));
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//Only bursts that start as LTTO are judged - another protocol's long leader isn't a collision.
+static void checkCollisions(ESP32_IRrxBase &_rx)
+{
+    std::vector<rmt_item32_t> _nec      = encodeNEC(0x20DF10EF);
+    std::vector<rmt_item32_t> _merged   = encodeBurst(TAG_PACKET_HEADER, 0x02, PACKET_BIT_COUNT);
+    std::vector<rmt_item32_t> _lost     = _merged;
+    std::vector<rmt_item32_t> _joined   = encodeBurst(TAG_PACKET_HEADER, 0x2B, TAG_BIT_COUNT);
+    _merged[4].duration0    = 9000;                             //two marks run together
+    _lost[0].duration0      = 9000;                             //...over the pre-sync, the header is still there
+    _joined.back().duration1 = MARK_SPACE;                      //a second packet with no gap
+    _joined.insert(_joined.end(), _joined.begin(), _joined.end());
+    _joined.back().duration1 = 0;
+
+    uint32_t _count = _rx.readCollisionCount();
+    bool _ok = !decodeBurst(_rx, _nec) && !_rx.readCollision();
+    _ok = _ok && !decodeBurst(_rx, _nec) && !_rx.readCollision();
+    check(_ok && _rx.readCollisionCount() == _count, "a NEC frame is not a collision");
+
+    _ok = !decodeBurst(_rx, _merged) && _rx.readCollision();
+    _ok = _ok && !decodeBurst(_rx, _lost) && _rx.readCollision();
+    _ok = _ok && !decodeBurst(_rx, _joined) && _rx.readCollision();
+    check(_ok && _rx.readCollisionCount() == _count + 3, "overlapping LTTO packets are collisions");
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//The RMT ends a burst on the idle threshold, so a packet's last bit has no space - whatever is there
+//isn't checked. Every space before it still is.
+static void checkLastSpace()
+{
+    static const struct { unsigned int header; uint32_t data; int bits; char type; } _packets[] =
+    {
+        { TAG_PACKET_HEADER,    0x2B,   TAG_BIT_COUNT,          'T' },
+        { TAG_PACKET_HEADER,    0x02,   PACKET_BIT_COUNT,       'P' },
+        { TAG_PACKET_HEADER,    0x1A5,  PACKET_BIT_COUNT,       'C' },
+        { TAG_PACKET_HEADER,    0xC3,   DATA_BIT_COUNT,         'D' },
+        { BEACON_HEADER,        0x15,   BEACON_BIT_COUNT,       'Z' },
+        { BEACON_HEADER,        0x0F3,  LTAR_BEACON_BIT_COUNT,  'E' },
+    };
+    bool _ok = true;
+
+    for(size_t index = 0; index < sizeof(_packets) / sizeof(_packets[0]); index++)
+    {
+        std::vector<rmt_item32_t> _items = encodeBurst(_packets[index].header, _packets[index].data, _packets[index].bits);
+        LttoMessage _message;
+        for(uint32_t _space : { 0, 300, MARK_SPACE, RX_IDLE_US })
+        {
+            _items.back().duration1 = _space;
+            _ok = _ok && ESP32_IRrxBase::parseLTTO(_items.data(), _items.size(), _message)
+                      && _message.type == _packets[index].type && _message.data == _packets[index].data;
+        }
+        _items[_items.size() - 2].duration1 = 300;          //the space before the last bit
+        _ok = _ok && !ESP32_IRrxBase::parseLTTO(_items.data(), _items.size(), _message);
+    }
+    check(_ok, "the space after the last bit isn't checked, the ones before it are");
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//BRX: 2mS start, then 1mS ones and 0.5mS zeros, all with 0.5mS spaces - given here as _space, and
+//the zeros as _zero, to put them near the edge of the decoder's tolerance.
+static std::vector<rmt_item32_t> encodeBRX(uint32_t _data, int _bitCount, uint32_t _zero, uint32_t _space)
+{
+    std::vector<rmt_item32_t> _items;
+    _items.push_back(item(2000, _space));
+    for(int index = _bitCount - 1; index >= 0; index--)
+    {
+        _items.push_back(item(((_data >> index) & 1) ? 1000 : _zero, index ? _space : 0));
+    }
+    return _items;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//Through the ring buffer, checking what the glitch filter left and what it decoded to.
+static bool decodeFiltered(ESP32_IRrxBase &_rx, const std::vector<rmt_item32_t> &_items,
+                           const std::vector<rmt_item32_t> &_expected, char _type, uint16_t _data)
+{
+    shimReceive(RX_CHANNEL, _items.data(), _items.size());
+    ESP32_IRrxItem _rxItem = _rx.receiveItem(0);
+    bool _ok = _rxItem.size() == (int)_expected.size();
+    for(int index = 0; _ok && index < _rxItem.size(); index++)
+    {
+        _ok = _rxItem.data()[index].duration0 == _expected[index].duration0
+           && _rxItem.data()[index].duration1 == _expected[index].duration1;
+    }
+    return _ok && _rx.decodeIR(_rxItem) && _rx.readMessageType() == _type && _rx.readRawDataPacket() == _data;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//The glitch filter takes its thresholds from the protocol the burst's sync dispatches to - LTTO's are
+//4 times BRX's. A split mark is joined, runts at either end are dropped, and a burst's 0 final space
+//is its end, not a glitch.
+static void checkGlitches(ESP32_IRrxBase &_rx)
+{
+    std::vector<rmt_item32_t> _tag      = encodeBurst(TAG_PACKET_HEADER, 0x2B, TAG_BIT_COUNT);
+    std::vector<rmt_item32_t> _split    = _tag;
+    std::vector<rmt_item32_t> _runts    = _tag;
+    _split[1]                   = item(1400, 300);              //the header, split over RX_GLITCH_GAP_US
+    _split.insert(_split.begin() + 2, item(TAG_PACKET_HEADER - 1400 - 300, MARK_SPACE));
+    _runts.insert(_runts.begin(), item(150, 4000));             //a runt before the pre-sync
+    _runts.back().duration1     = 1500;                         //...and one after the last bit
+    _runts.push_back(item(100, 0));
+
+    _rx.clearGlitchCounters();
+    bool _ok = decodeFiltered(_rx, _tag, _tag, 'T', 0x2B) && _rx.readGlitchBurstsRepaired() == 0;
+    check(_ok, "a clean burst ending on a 0 space is left alone");
+
+    _ok = decodeFiltered(_rx, _split, _tag, 'T', 0x2B) && _rx.readGlitchGapsMerged() == 1;
+    check(_ok, "a mark split by 300uS is joined again (LTTO)");
+
+    _ok = decodeFiltered(_rx, _runts, _tag, 'T', 0x2B) && _rx.readGlitchMarksDropped() == 2;
+    check(_ok, "runts at the start and the end are dropped, the last space is 0 again");
+
+    //BRX zeros and spaces of 420uS - LTTO's thresholds would have joined every bit to the next
+    std::vector<rmt_item32_t> _brx      = encodeBRX(0xA5, 8, 420, 420);
+    std::vector<rmt_item32_t> _brxSplit = _brx;
+    _brxSplit[3]                = item(450, 100);               //a one, split
+    _brxSplit.insert(_brxSplit.begin() + 4, item(1000 - 450 - 100, 420));
+    _ok = decodeFiltered(_rx, _brx, _brx, 'B', 0xA5) && _rx.readGlitchBurstsRepaired() == 2;
+    _ok = _ok && decodeFiltered(_rx, _brxSplit, _brx, 'B', 0xA5) && _rx.readGlitchGapsMerged() == 2;
+    check(_ok, "BRX keeps its 420uS spaces, and a split is still joined");
+
+    _rx.setGlitchFilter(0, 0);
+    shimReceive(RX_CHANNEL, _split.data(), _split.size());
+    ESP32_IRrxItem _rxItem = _rx.receiveItem(0);
+    _ok = _rxItem.size() == (int)_split.size() && !_rx.decodeIR(_rxItem) && _rx.readGlitchBurstsRepaired() == 3;
+    _rxItem = ESP32_IRrxItem();
+    _rx.setGlitchFilter(RX_GLITCH_GAP_US, RX_GLITCH_MARK_US);
+    check(_ok, "setGlitchFilter(0, 0) turns it off");
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+    ESP32_IRrx<> _rx;
+    _rx.ESP32_IRrxPIN(RX_PIN, RX_CHANNEL);
+    _rx.initReceive();
+
+    checkLastSpace();
+    checkBurstEnds(_rx);
+    checkCollisions(_rx);
+    checkGlitches(_rx);
+
+    printf("%d failed\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,287 @@
+ /* Copyright (c) 2018 Richie Mickan. All Rights Reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>. *
+ */
+
+/* Golden Tx frames. Each sender's frame goes through the RMT translator (see shim/shim.cpp), and the
+ * items that come out are checked against the numbers recorded here: how many there are, a hash of
+ * the whole stream, and the airtime they add up to - which readLastFrameAirtime() must agree with.
+ * Every packet in the frame must also decode with the receiver's parseLTTO() (the BRX test frame aside).
+ * Senders that build the same frame another way (sendLttoIR(String), assignPlayer() from a roster)
+ * share that frame's numbers, and the beacon autopilot's timer must write sendBeacon()'s items. So do
+ * hosting frames copied from the frame cache.
+ * If an encoding change is meant to change a frame, update its numbers here in the same commit.
+ */
+
+#include "Arduino.h"
+#include "ESP32_IR_LTTO.h"
+#include "ESP32_IR_Roster.h"
+#include "shim.h"
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+static int failures = 0;
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+static void check(bool _ok, const char *_what)
+{
+    if(!_ok)    failures++;
+    printf("%-4s %s\n", _ok ? "ok" : "FAIL", _what);
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//FNV-1a over the items as the RMT gets them
+static uint32_t streamHash()
+{
+    uint32_t _hash = 2166136261UL;
+    for(size_t index = 0; index < shimItems.size(); index++)
+    {
+        uint32_t _val = shimItems[index].val;
+        for(int _byte = 0; _byte < 4; _byte++)  _hash = (_hash ^ ((_val >> (_byte * 8)) & 0xFF)) * 16777619UL;
+    }
+    return _hash;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+static int streamAirtime()
+{
+    int _airtime = 0;
+    for(size_t index = 0; index < shimItems.size(); index++)  _airtime += shimItems[index].duration0 + shimItems[index].duration1;
+    return _airtime;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//Splits the stream into packets at the gaps, and returns how many don't decode.
+static int badPackets()
+{
+    int _bad    = 0;
+    int _count  = shimItems.size();
+    int index   = 0;
+
+    while(index < _count)
+    {
+        int _start = index;
+        while(index < _count && shimItems[index].level0)    index++;
+        int _marks = index - _start;
+        while(index < _count && !shimItems[index].level0)   index++;
+        if(_marks == 0) break;              //end marker
+
+        LttoMessage _message;
+        if(!ESP32_IRrxBase::parseLTTO(&shimItems[_start], _marks, _message))   _bad++;
+    }
+    return _bad;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//_isLtto false for frames parseLTTO() can't decode (BRX)
+static void checkFrame(const char *_sender, ESP32_IRtxBase &_tx, int _items, uint32_t _hash, int _airtime, bool _isLtto = true)
+{
+    bool _ok = (int)shimItems.size() == _items && streamHash() == _hash && streamAirtime() == _airtime
+               && _tx.readLastFrameAirtime() == _airtime && (!_isLtto || badPackets() == 0);
+    if(!_ok)    failures++;
+    printf("%-4s %-36s items %4d  hash 0x%08X  airtime %7d  (sent airtime %7d, %d bad packets)\n",
+           _ok ? "ok" : "FAIL", _sender, (int)shimItems.size(), streamHash(), streamAirtime(),
+           _tx.readLastFrameAirtime(), badPackets());
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//The tag is short enough to check item by item - pre-sync, tag header, the 7 bits (team 01,
+//player-1 001, power 11), the gap as two halves, then the end markers.
+static void checkTagItems()
+{
+    static const uint16_t _expected[][4] =
+    {
+        {3000, 1, 6000, 0}, {3000, 1, 2000, 0},
+        {1000, 1, 2000, 0}, {2000, 1, 2000, 0}, {1000, 1, 2000, 0}, {1000, 1, 2000, 0},
+        {2000, 1, 2000, 0}, {2000, 1, 2000, 0}, {2000, 1, 2000, 0},
+        {28000, 0, 28000, 0},
+        {0, 0, 0, 0}, {0, 0, 0, 0},
+    };
+    bool _ok = shimItems.size() == sizeof(_expected) / sizeof(_expected[0]);
+    for(size_t index = 0; _ok && index < sizeof(_expected) / sizeof(_expected[0]); index++)
+    {
+        _ok = shimItems[index].duration0 == _expected[index][0] && shimItems[index].level0 == _expected[index][1]
+           && shimItems[index].duration1 == _expected[index][2] && shimItems[index].level1 == _expected[index][3];
+    }
+    if(!_ok)    failures++;
+    printf("%-4s %-36s\n", _ok ? "ok" : "FAIL", "sendTag(1,2,3) items");
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+static bool sameItems(const std::vector<rmt_item32_t> &_expected)
+{
+    return shimItems.size() == _expected.size()
+        && memcmp(shimItems.data(), _expected.data(), _expected.size() * sizeof(rmt_item32_t)) == 0;
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//The autopilot's timer must put out the very items sendBeacon() would, before and after an update,
+//and nothing once it is stopped.
+static void checkBeaconAutopilot(ESP32_IRtxBase &_tx)
+{
+    _tx.sendBeacon(false, 2, 1);
+    std::vector<rmt_item32_t> _beacon = shimItems;
+    _tx.sendBeacon(true, 3, 1);
+    std::vector<rmt_item32_t> _tagged = shimItems;
+    _tx.sendLTARbeacon(true, true, 2, 0, 1);
+    std::vector<rmt_item32_t> _ltar = shimItems;
+
+    bool _ok = _tx.startBeaconAutopilot(500, 2, 1);
+    shimItems.clear();
+    shimTimers();
+    _ok = _ok && sameItems(_beacon);
+    _tx.updateBeaconAutopilot(true, false, 0, 3);
+    shimTimers();
+    _ok = _ok && sameItems(_tagged);
+    _tx.stopBeaconAutopilot();
+    shimItems.clear();
+    shimTimers();
+    _ok = _ok && shimItems.empty() && !_tx.isBeaconAutopilotRunning();
+
+    _ok = _ok && _tx.startBeaconAutopilot(500, 1, 0, true);
+    _tx.updateBeaconAutopilot(true, true, 2, 1);
+    shimTimers();
+    _ok = _ok && sameItems(_ltar);
+    _tx.stopBeaconAutopilot();
+
+    if(!_ok)    failures++;
+    printf("%-4s %-36s\n", _ok ? "ok" : "FAIL", "beacon autopilot (LTTO, LTAR)");
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+//An unchanged hosting frame comes from the cache, with the same items - a changed one is encoded
+//again. ESP32_IR has room for IR_FRAME_CACHE_SIZE frames, ESP32_IRtx<> has none and says so.
+static void checkFrameCache(ESP32_IRtxBase &_uncached)
+{
+    ESP32_IR _ir;
+    _ir.ESP32_IRtxPIN(4, 2);
+    _ir.initTransmit();
+
+    bool _ok = !_uncached.setFrameCache(true) && _ir.setFrameCache(true);
+    check(_ok, "setFrameCache(true) fails only without a FRAME_CACHE_SIZE");
+
+    _ir.hostPlayerToGame(0, 0, 2, 0x40, 10, 25, 99, 15, 0, 0, 0);
+    _ok = _ir.readFrameCacheMisses() == 1 && _ir.readFrameCacheHits() == 0;
+    _ir.hostPlayerToGame(0, 0, 2, 0x40, 10, 25, 99, 15, 0, 0, 0);
+    _ok = _ok && _ir.readFrameCacheMisses() == 1 && _ir.readFrameCacheHits() == 1;
+    check(_ok, "an unchanged announce is a cache hit");
+    checkFrame("hostPlayerToGame (LTTO, cached)",   _ir, 115, 0x93BD9691, 708000);
+
+    _ir.hostPlayerToGame(0, 0, 2, 0x55, 10, 25, 99, 15, 10, 0, 0);
+    _ok = _ir.readFrameCacheMisses() == 2 && _ir.readFrameCacheHits() == 1;
+    check(_ok, "a changed announce is a miss");
+    checkFrame("hostPlayerToGame (0x55, encoded)",  _ir, 115, 0xA2A15281, 712000);
+    _ir.hostPlayerToGame(0, 0, 2, 0x55, 10, 25, 99, 15, 10, 0, 0);
+    _ok = _ir.readFrameCacheMisses() == 2 && _ir.readFrameCacheHits() == 2;
+    check(_ok, "...and then a hit");
+    checkFrame("hostPlayerToGame (0x55, cached)",   _ir, 115, 0xA2A15281, 712000);
+
+    _ir.assignPlayer(0x40, 77, 1, 2);
+    _ir.assignPlayer(0x40, 77, 1, 2);
+    _ok = _ir.readFrameCacheMisses() == 3 && _ir.readFrameCacheHits() == 3;
+    _ir.assignPlayer(0x40, 77, 2, 1);
+    _ok = _ok && _ir.readFrameCacheMisses() == 4 && _ir.readFrameCacheHits() == 3;
+    check(_ok, "assignPlayer() to the same player hits, to another misses");
+    checkFrame("assignPlayer (team 2 player 1)",    _ir,  59, 0x437A9C71, 389000);
+
+    _ok = _ir.setFrameCache(false);
+    _ir.hostPlayerToGame(0, 0, 2, 0x40, 10, 25, 99, 15, 0, 0, 0);
+    _ok = _ok && _ir.readFrameCacheMisses() == 4 && _ir.readFrameCacheHits() == 3;
+    check(_ok, "setFrameCache(false) stops caching");
+    _ir.stopIR();
+}
+
+//////////////////////////////////////////////////////////////////////////////////////////
+
+int main()
+{
+    ESP32_IRtx<> _tx;
+    _tx.ESP32_IRtxPIN(4, 0);
+    _tx.initTransmit();
+
+    _tx.sendTag(1, 2, 3);
+    checkTagItems();
+    checkFrame("sendTag(1,2,3)",                    _tx,  12, 0xF80EEE31,  95000);
+    _tx.sendBeacon(false, 1, 0);
+    checkFrame("sendBeacon",                        _tx,  10, 0x7CC157C1,  58000);
+    _tx.sendLTARbeacon(true, false, 3, 0, 2);
+    checkFrame("sendLTARbeacon",                    _tx,  14, 0x8DBD6995,  73000);
+    _tx.sendZoneBeacon(2, 1);
+    checkFrame("sendZoneBeacon",                    _tx,  10, 0x52067B61,  60000);
+    _tx.sendLTAG(3);
+    checkFrame("sendLTAG",                          _tx,  12, 0xD994C731,  93000);
+    _tx.sendIR('T', 0x2B);                                          //a tag, as sendTag(1,3,3)
+    checkFrame("sendIR('T')",                       _tx,  12, 0x62B899A1,  95000);
+    _tx.sendLttoIR('T', 0x2B);
+    checkFrame("sendLttoIR('T')",                   _tx,  12, 0x62B899A1,  95000);
+    _tx.sendTag(1, 3, 3);
+    checkFrame("sendTag(1,3,3)",                    _tx,  12, 0x62B899A1,  95000);
+    _tx.sendBrxTest();
+    checkFrame("sendBrxTest",                       _tx,  28, 0x23300B17,  39500, false);
+    checkBeaconAutopilot(_tx);
+    _tx.hostPlayerToGame(0, 0, 2, 0x40, 10, 25, 99, 15, 0, 0, 0);
+    checkFrame("hostPlayerToGame (LTTO)",           _tx, 115, 0x93BD9691, 708000);
+    _tx.hostPlayerToGame(0, 0, 2, 0x40, 10, 25, 99, 15, 0, 0, 0, 5);
+    checkFrame("hostPlayerToGame (LTAR)",           _tx, 125, 0x09F06EE1, 777000);
+    _tx.hostPlayerToGame(0, 0, 2, 0x55, 10, 25, 99, 15, 10, 0, 0);
+    checkFrame("hostPlayerToGame (LTTO, 0x55)",     _tx, 115, 0xA2A15281, 712000);
+    _tx.assignPlayer(0x40, 77, 1, 2);
+    checkFrame("assignPlayer",                      _tx,  59, 0x4ED46905, 390000);
+    _tx.assignPlayerFailed(0x40, 77);
+    checkFrame("assignPlayerFailed",                _tx,  49, 0xB5AC1935, 327000);
+
+    //From a roster - the same frames. Team 1 has a player already, so the roster balances 77 onto team 2.
+    _tx.assignPlayer(0x40, 77, 2, 1);
+    checkFrame("assignPlayer (team 2 player 1)",    _tx,  59, 0x437A9C71, 389000);
+    ESP32_IRroster _roster;
+    _roster.addTagger(76, 1);
+    _tx.assignPlayer(0x40, _roster, 77, 1);
+    checkFrame("assignPlayer (roster)",             _tx,  59, 0x437A9C71, 389000);
+    for(int _tagger = 0; _tagger < MAX_ROSTER_PLAYERS; _tagger++)   _roster.addTagger(100 + _tagger, 1);
+    _tx.assignPlayer(0x40, _roster, 77, 1);                         //already in, so assigned again
+    checkFrame("assignPlayer (roster, again)",      _tx,  59, 0x437A9C71, 389000);
+    _tx.assignPlayer(0x40, _roster, 78, 1);                         //the game is full
+    checkFrame("assignPlayer (roster, full)",       _tx,  49, 0xD0B37651, 328000);
+    _tx.assignPlayerFailed(0x40, 78);
+    checkFrame("assignPlayerFailed (78)",           _tx,  49, 0xD0B37651, 328000);
+    _tx.ltarAssignPlayerSuccess(0x40, 1, 2);
+    checkFrame("ltarAssignPlayerSuccess",           _tx,  49, 0xE5F3D891, 324000);
+    _tx.requestTagReport(0x40, 1, 2, 7);
+    checkFrame("requestTagReport",                  _tx,  71, 0x8F7A1D35, 455000);
+    _tx.taggerRequestToJoin(0x40, 77, 1);
+    checkFrame("taggerRequestToJoin",               _tx,  59, 0x05180C71, 389000);
+    _tx.sendLttoIR(String(" P16:D64:D77:D1:C:\r\n"));                //the same message, as the serial protocol has it
+    checkFrame("sendLttoIR(String)",                _tx,  59, 0x05180C71, 389000);
+    _tx.taggerAckPlayerAssign(0x40, 77);
+    checkFrame("taggerAckPlayerAssign",             _tx,  49, 0xF00500A1, 326000);
+    _tx.taggerTagSummary(0x40, 0x12, 3, 1, 2, 0, 5, 7);
+    checkFrame("taggerTagSummary",                  _tx, 115, 0x567AF441, 708000);
+    _tx.taggerTeamReport(1, 0x40, 0x12, 0b00000101, 1, 2, 3, 4, 5, 6, 7, 8);
+    checkFrame("taggerTeamReport (players 1, 3)",   _tx,  81, 0x9BD9CFF1, 517000);
+    _tx.taggerTeamReport(1, 0x40, 0x12, 0xFF, 1, 2, 3, 4, 5, 6, 7, 8);
+    checkFrame("taggerTeamReport (players 1-8)",    _tx, 147, 0xB58F8A45, 912000);
+    checkFrameCache(_tx);
+
+    printf("%d failed\n", failures);
+    return failures ? 1 : 0;
+}